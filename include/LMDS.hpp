@@ -2,12 +2,55 @@
 #define LMDS_HPP
 
 #include <LEDMatrixDriver.hpp>
+#include <frame_mirror.hpp>
+#include <SPI.h>
+#include <driver/spi_master.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <string.h>
 
+// Double buffered: renderers draw into the LEDMatrixDriver buffer (the back buffer) with the usual
+// clear()/print/setPixel calls, present() copies the finished frame into the front buffer and sends that.
+// The matrix only ever gets complete frames, however long drawing the next one takes.
+// Only the rows that differ from the last sent frame go out, see flush().
+// By default the task calling present() sends the frame, SPI.transfer16() polls until each word is
+// out. After beginAsyncFlush() the rows are queued to the spi_master driver as DMA transactions and
+// present() returns while they are clocked out; the next present() sleeps (ulTaskNotifyTake, woken
+// from the transaction ISR) until the last row is out before it touches the buffers again.
 class LMDS : public LEDMatrixDriver
 {
 public:
-    LMDS(uint8_t modules, uint8_t pin_cs) : LEDMatrixDriver(modules, pin_cs) {}
-    ~LMDS() {}
+    struct FlushStats
+    {
+        uint32_t frames;            // presented
+        uint32_t fullFlushes;       // all rows sent
+        uint32_t rowsSent;
+        uint32_t noops;             // unchanged modules skipped in a sent row
+        uint32_t bytesSent;
+        uint32_t bytesSaved;        // compared to sending every row of every frame
+    };
+
+    LMDS(uint8_t modules, uint8_t pin_cs)
+        : LEDMatrixDriver(modules, pin_cs), pin_cs(pin_cs),
+          front(new uint8_t[modules * ROWS]()), sent(new uint8_t[modules * ROWS]())
+    {
+        frontLock = xSemaphoreCreateMutex();
+        portMUX_INITIALIZE(&busLock);
+    }
+    ~LMDS()
+    {
+        if (bus != nullptr) {
+            waitForBus();
+            spi_bus_remove_device(bus);
+            spi_bus_free(SPI2_HOST);
+            heap_caps_free(words);
+        }
+        delete[] front;
+        delete[] sent;
+        vSemaphoreDelete(frontLock);
+    }
 
     void begin() {
         setEnabled(true);
@@ -16,6 +59,45 @@ public:
         display();
     }
 
+    // Raw access to the packed frame buffer: each row is getSegments() bytes,
+    // the MSB of every byte is the leftmost pixel of a module.
+    // LMDS never sets the INVERT_* flags so no remapping is needed.
+    uint8_t* rowPtr(uint8_t y) {
+        return getFrameBuffer() + y * getSegments();
+    }
+
+    // Moves the chain from the Arduino SPI class to the spi_master driver, with the same clock, mode
+    // and CS pin. Call after begin(); from then on the LEDMatrixDriver calls that talk to the chain
+    // themselves (display(), setIntensity() ...) must not be used. Stays synchronous if the bus
+    // cannot be set up.
+    bool beginAsyncFlush() {
+        xSemaphoreTake(frontLock, portMAX_DELAY);
+        bool ok = bus != nullptr || startBus();
+        xSemaphoreGive(frontLock);
+        return ok;
+    }
+
+    // Swaps in a finished frame: the back buffer is copied to the front buffer, which is sent to the
+    // matrix and to the frame mirror. Drawing may go on right after, the back buffer keeps its content.
+    // With the async flush it only waits when the rows of the previous frame are still going out.
+    void present() {
+        xSemaphoreTake(frontLock, portMAX_DELAY);
+        if (bus != nullptr)
+            waitForBus();
+        memcpy(front, getFrameBuffer(), getSegments() * ROWS);
+        flush(stats);
+        FrameMirror::publish(front, getSegments());
+        xSemaphoreGive(frontLock);
+    }
+
+    FlushStats getFlushStats() {
+        xSemaphoreTake(frontLock, portMAX_DELAY);
+        FlushStats copy = stats;
+        xSemaphoreGive(frontLock);
+        return copy;
+    }
+
+    // ASCII dump of the frame, handy for one-off debugging but too slow for render loops
     template <class S>
     void displayToSerial(S& serial) {
         for (int y = 0; y < 8; y++) {
@@ -26,6 +108,181 @@ public:
         }
         serial.println();
     }
+
+private:
+    static const uint8_t ROWS = 8;
+    static const uint16_t NOOP = 0x0000;    // MAX7219 no-op register, the module keeps what it shows
+    static const int CLOCK_HZ = 5000000;    // as LEDMatrixDriver
+
+    // Sends the rows of the front buffer that differ from the last sent frame. In such a row the
+    // unchanged modules get a no-op, the chain is shifted as a whole so every module needs a command.
+    // When more than half of the rows changed (scrolling) or nothing was sent yet, every row is sent.
+    void flush(FlushStats& counts) {
+        uint8_t modules = getSegments();
+        uint8_t dirtyRows = 0;
+        for (uint8_t row = 0; row < ROWS; row++)
+            if (not sentValid || memcmp(front + row * modules, sent + row * modules, modules) != 0)
+                dirtyRows |= 1 << row;
+
+        bool full = not sentValid || __builtin_popcount(dirtyRows) > ROWS / 2;
+        counts.frames++;
+        counts.fullFlushes += full;
+        //counted before the first one is queued, it may be out before the next is
+        if (bus != nullptr) {
+            taskENTER_CRITICAL(&busLock);
+            remaining = full ? ROWS : __builtin_popcount(dirtyRows);
+            taskEXIT_CRITICAL(&busLock);
+        }
+        for (uint8_t row = 0; row < ROWS; row++) {
+            if (full || (dirtyRows & (1 << row)))
+                sendRow(row, full, counts);
+            else
+                counts.bytesSaved += modules * 2;
+        }
+
+        memcpy(sent, front, modules * ROWS);
+        sentValid = true;
+    }
+
+    // one digit register per module the way LEDMatrixDriver::display() does it: module 0 first,
+    // no INVERT_* remapping. The chain latches on the rising CS edge, so every row is a CS frame of
+    // its own, and with the async flush a transaction of its own
+    void sendRow(uint8_t row, bool full, FlushStats& counts) {
+        static const SPISettings settings(CLOCK_HZ, MSBFIRST, SPI_MODE0);
+        uint8_t modules = getSegments();
+        const uint8_t* data = front + row * modules;
+        const uint8_t* previous = sent + row * modules;
+        //big endian, the register byte goes out first
+        uint8_t* bytes = bus != nullptr ? words + row * modules * 2 : nullptr;
+
+        if (bytes == nullptr) {
+            digitalWrite(pin_cs, LOW);
+            SPI.beginTransaction(settings);
+        }
+        for (uint8_t module = 0; module < modules; module++) {
+            uint16_t word = NOOP;
+            if (full || data[module] != previous[module])
+                word = uint16_t(row + 1) << 8 | data[module];
+            else
+                counts.noops++;
+
+            if (bytes == nullptr)
+                SPI.transfer16(word);
+            else {
+                bytes[module * 2] = word >> 8;
+                bytes[module * 2 + 1] = word & 0xFF;
+            }
+        }
+        if (bytes == nullptr) {
+            digitalWrite(pin_cs, HIGH);
+            SPI.endTransaction();
+        }
+        else {
+            spi_transaction_t& transaction = transactions[row];
+            memset(&transaction, 0, sizeof(transaction));
+            transaction.length = modules * 16;
+            transaction.tx_buffer = bytes;
+            transaction.user = this;
+            spi_device_queue_trans(bus, &transaction, portMAX_DELAY);
+            queued++;
+        }
+
+        counts.rowsSent++;
+        counts.bytesSent += modules * 2;
+    }
+
+    // with frontLock held
+    bool startBus() {
+        uint8_t modules = getSegments();
+        words = static_cast<uint8_t*>(heap_caps_malloc(ROWS * modules * 2, MALLOC_CAP_DMA));
+        if (words == nullptr) {
+            Serial.println("LMDS: no DMA memory, the display stays synchronous");
+            return false;
+        }
+
+        //SPIClass drives SPI2 through the HAL, it has to let go before the driver claims the bus
+        SPI.end();
+        spi_bus_config_t config = {};
+        config.mosi_io_num = MOSI;
+        config.miso_io_num = -1;
+        config.sclk_io_num = SCK;
+        config.quadwp_io_num = -1;
+        config.quadhd_io_num = -1;
+        config.max_transfer_sz = modules * 2;
+        esp_err_t result = spi_bus_initialize(SPI2_HOST, &config, SPI_DMA_CH_AUTO);
+
+        if (result == ESP_OK) {
+            spi_device_interface_config_t device = {};
+            device.mode = 0;
+            device.clock_speed_hz = CLOCK_HZ;
+            device.spics_io_num = pin_cs;
+            device.queue_size = ROWS;
+            device.post_cb = transaction_done;
+            result = spi_bus_add_device(SPI2_HOST, &device, &bus);
+            if (result != ESP_OK)
+                spi_bus_free(SPI2_HOST);
+        }
+
+        if (result != ESP_OK) {
+            Serial.printf("LMDS: spi_master setup failed (%d), the display stays synchronous\n", (int)result);
+            bus = nullptr;
+            heap_caps_free(words);
+            words = nullptr;
+            SPI.begin();
+            return false;
+        }
+        return true;
+    }
+
+    // Sleeps until the transactions of the last frame are out, then collects them from the driver.
+    // The rows buffer and the transactions belong to the driver until then.
+    void waitForBus() {
+        while (true) {
+            taskENTER_CRITICAL(&busLock);
+            bool busy = remaining > 0;
+            waiter = busy ? xTaskGetCurrentTaskHandle() : nullptr;
+            taskEXIT_CRITICAL(&busLock);
+            if (not busy)
+                break;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        spi_transaction_t* done;
+        for (; queued > 0; queued--)
+            spi_device_get_trans_result(bus, &done, portMAX_DELAY);
+    }
+
+    // post_cb of every transaction, runs in the SPI interrupt
+    static void transaction_done(spi_transaction_t* transaction) {
+        LMDS* display = static_cast<LMDS*>(transaction->user);
+        TaskHandle_t waiting = nullptr;
+        taskENTER_CRITICAL_ISR(&display->busLock);
+        if (--display->remaining == 0) {
+            waiting = display->waiter;
+            display->waiter = nullptr;
+        }
+        taskEXIT_CRITICAL_ISR(&display->busLock);
+
+        BaseType_t woken = pdFALSE;
+        if (waiting != nullptr)
+            vTaskNotifyGiveFromISR(waiting, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+
+    const uint8_t pin_cs;
+    uint8_t* front;                 // last presented frame, with frontLock held
+    uint8_t* sent;                  // what the matrix shows, as far as flush() knows
+    bool sentValid = false;
+    FlushStats stats = {};
+    SemaphoreHandle_t frontLock;
+
+    spi_device_handle_t bus = nullptr;      // set by beginAsyncFlush()
+    uint8_t* words = nullptr;               // the rows as they go out, DMA capable
+    spi_transaction_t transactions[ROWS];   // one per row, queued with frontLock held
+    uint8_t queued = 0;                     // not collected from the driver yet, with frontLock held
+    portMUX_TYPE busLock;
+    uint8_t remaining = 0;                  // queued and not out yet, with busLock held
+    TaskHandle_t waiter = nullptr;          // present() sleeping until remaining is 0, with busLock held
 };
 
 
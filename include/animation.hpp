@@ -0,0 +1,43 @@
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#pragma once
+
+#include <LMDS.hpp>
+#include <functional>
+
+// An animation is a state machine producing numbered frames.
+// The engine may skip frame numbers when it falls behind, so renderFrame has to be able
+// to jump from any earlier frame to the requested one.
+class Animation
+{
+public:
+    virtual ~Animation() {}
+
+    virtual uint32_t frameCount() const = 0;
+    virtual void renderFrame(LMDS& display, uint32_t frame) = 0;
+};
+
+struct AnimationStats
+{
+    uint32_t frames;            // frames presented
+    uint32_t dropped;           // frames skipped to catch up with the schedule
+    int32_t minLatenessUs;      // frame start relative to its deadline
+    int32_t maxLatenessUs;
+    int64_t totalLatenessUs;
+
+    int32_t averageLatenessUs() const { return frames ? totalLatenessUs / frames : 0; }
+    int32_t jitterUs() const { return frames ? maxLatenessUs - minLatenessUs : 0; }
+};
+
+// Runs the animation with one frame every framePeriodMs, deadlines are absolute
+// (vTaskDelayUntil) so render and SPI time do not stretch the frame period.
+// The last frame is always presented unless the animation is preempted, either by a higher priority
+// display request or by stop() returning true.
+AnimationStats runAnimation(Animation& animation, LMDS& display, uint32_t framePeriodMs,
+                            const std::function<bool()>& stop = nullptr);
+
+// accumulated over all runs since boot
+AnimationStats getAnimationStats();
+
+#endif // ANIMATION_HPP
@@ -0,0 +1,59 @@
+#ifndef BOOT_PROGRESS_HPP
+#define BOOT_PROGRESS_HPP
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+// Brings the network up without holding up the display: the compositor and the clock run from the start
+// while WiFi connects (or the configuration portal waits for the user) and NTP syncs in the background.
+// The current step is shown on the matrix, the milestones are logged and recorded in the metrics
+// as the time since power-up.
+class BootProgress
+{
+public:
+    enum Milestone { FIRST_FRAME, WIFI, TIME, FIRST_CONTENT, MILESTONE_COUNT };
+
+    static const uint32_t WIFI_CONNECT_TIMEOUT_MS = 15000;  // for the saved network, then the portal opens
+    static const uint32_t POLL_PERIOD_MS = 50;              // while connecting or running the portal
+
+    static BootProgress& getInstance()
+    {
+        static BootProgress instance;
+        return instance;
+    }
+
+    BootProgress(const BootProgress&) = delete;
+    BootProgress& operator=(const BootProgress&) = delete;
+
+    // starts connecting and NTP, returns right away. onOnline runs from poll() once WiFi is connected
+    void begin(std::function<void()> onOnline);
+
+    // one step of the WiFi connect or the portal, returns the ms until it wants to run again
+    uint32_t poll();
+
+    // only the first call of every milestone counts, may be called from any task
+    void reached(Milestone milestone);
+
+    bool timeSet() const { return times[TIME].load(std::memory_order_relaxed) != 0; }
+
+private:
+    BootProgress() = default;
+
+    enum class State { Idle, Connecting, Portal, Online, Done };
+
+    void startPortal();
+    void showStatus(const std::string& text);
+
+    State state = State::Idle;
+    uint32_t connectStart = 0;
+    std::string status;
+    std::function<void()> onOnline;
+    std::atomic<uint32_t> times[MILESTONE_COUNT] = {};     // millis() when reached, 0 before
+};
+
+#endif // BOOT_PROGRESS_HPP
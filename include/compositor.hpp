@@ -0,0 +1,81 @@
+#ifndef COMPOSITOR_HPP
+#define COMPOSITOR_HPP
+
+#pragma once
+
+#include <LMDS.hpp>
+#include <strip_cache.hpp>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Something the compositor can show. Producers build one and publish it,
+// publishing again with the same id replaces the previous version.
+struct ContentItem
+{
+    enum class Kind { Text, Strip, Render };
+    enum class Transition { None, Wipe, ScrollOut };
+
+    std::string id;
+    Kind kind = Kind::Text;
+
+    std::string text;                               // Kind::Text, rendered through the strip cache
+    std::shared_ptr<const MessageStrip> strip;      // Kind::Strip, rendered by the producer
+    std::function<void(LMDS&, uint32_t)> render;    // Kind::Render, called with the ms elapsed since the item started
+
+    uint32_t framePeriodMs = 50;    // scroll speed for text and strips, refresh period for render callbacks
+    uint32_t durationMs = 0;        // how long a render callback stays on
+    uint32_t intervalMs = 0;        // minimum pause between two showings of the item
+    uint32_t maxLatenessMs = UINT32_MAX;    // once due for longer than this, lower priority items are cut short
+    uint8_t priority = 0;           // ResourceManager priority, also decides which due item goes first
+    Transition transition = Transition::None;   // played when the item is done
+};
+
+// The only user of the LMDS in normal operation: a single task runs the playlist of published items,
+// so producers never lock the display or sleep while holding it.
+// The next item is the due one with the highest priority, equal priorities take turns.
+class Compositor
+{
+public:
+    static Compositor& getInstance()
+    {
+        static Compositor instance;
+        return instance;
+    }
+
+    Compositor(const Compositor&) = delete;
+    Compositor& operator=(const Compositor&) = delete;
+
+    void begin();
+
+    void publish(const ContentItem& item);
+    void remove(const std::string& id);
+
+private:
+    Compositor();
+
+    struct Entry
+    {
+        std::shared_ptr<const ContentItem> item;
+        TickType_t lastShown;   // end of the last showing
+        bool shown;
+    };
+
+    static void compositor_task_function(void* parameter);
+
+    std::shared_ptr<const ContentItem> pickNext();
+    bool overdueAbove(uint8_t priority);
+    bool isDue(const Entry& entry, TickType_t now) const;
+    void markShown(const std::string& id);
+    void show(const ContentItem& item, LMDS& display);
+
+    SemaphoreHandle_t mutex;
+    std::vector<Entry> entries;
+    TaskHandle_t task = nullptr;
+};
+
+#endif // COMPOSITOR_HPP
@@ -0,0 +1,111 @@
+#ifndef CONFIG_LINE_HPP
+#define CONFIG_LINE_HPP
+
+#pragma once
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// One line of the config file, "key = value", read and written by DataStore.
+// Free of Arduino so it can be tested on the host.
+namespace ConfigLine
+{
+    // Splits the line [begin, end) in place, end is the '\n' or the end of the arena and is
+    // overwritten. Returns false for blank lines and comments, and with error set for malformed ones.
+    inline bool parse_line(char* begin, char* end, char*& key, char*& value, const char*& error)
+    {
+        //trimming also drops the '\r' of CRLF lines
+        while (begin < end && isspace((unsigned char)*begin))
+            begin++;
+        while (end > begin && isspace((unsigned char)end[-1]))
+            end--;
+        *end = '\0';
+        if (begin == end || *begin == '#')
+            return false;
+
+        char* delimiter = static_cast<char*>(memchr(begin, '=', end - begin));
+        if (delimiter == nullptr)
+        {
+            error = "missing '='";
+            return false;
+        }
+
+        char* keyEnd = delimiter;
+        while (keyEnd > begin && isspace((unsigned char)keyEnd[-1]))
+            keyEnd--;
+        if (keyEnd == begin)
+        {
+            error = "empty key";
+            return false;
+        }
+        *keyEnd = '\0';
+
+        value = delimiter + 1;
+        while (value < end && isspace((unsigned char)*value))
+            value++;
+
+        if (*value == '"' || *value == '\'')
+        {
+            //unquoted in place, the text only gets shorter
+            char quote = *value;
+            char* in = value + 1;
+            char* out = value;
+            while (in < end && *in != quote)
+            {
+                if (quote == '"' && *in == '\\' && in + 1 < end)
+                {
+                    in++;
+                    *out++ = *in == 'n' ? '\n' : *in == 't' ? '\t' : *in;
+                    in++;
+                }
+                else
+                    *out++ = *in++;
+            }
+            if (in == end)
+            {
+                error = "missing closing quote";
+                return false;
+            }
+            for (in++; in < end && isspace((unsigned char)*in); in++)
+                ;
+            if (in < end && *in != '#')
+            {
+                error = "text after the closing quote";
+                return false;
+            }
+            *out = '\0';
+        }
+
+        key = begin;
+        return true;
+    }
+
+    // Writes the value the way parse_line() reads it back: as it is, or in double quotes when it
+    // starts or ends with whitespace, starts with a quote or spans lines. Out is anything with
+    // write(uint8_t) and write(const uint8_t*, size_t), a File on the device.
+    template <class Out>
+    bool write_value(Out& out, const char* text)
+    {
+        size_t length = strlen(text);
+        bool quote = length > 0 && (isspace((unsigned char)text[0]) || isspace((unsigned char)text[length - 1])
+            || text[0] == '"' || text[0] == '\'' || strpbrk(text, "\n\r") != nullptr);
+        if (not quote)
+            return out.write(reinterpret_cast<const uint8_t*>(text), length) == length;
+
+        bool ok = out.write('"') == 1;
+        for (const char* c = text; *c && ok; c++)
+        {
+            if (*c == '\n')
+                ok = out.write(reinterpret_cast<const uint8_t*>("\\n"), 2) == 2;
+            else if (*c == '"' || *c == '\\')
+                ok = out.write('\\') == 1 && out.write(*c) == 1;
+            else
+                ok = out.write(*c) == 1;
+        }
+        return ok && out.write('"') == 1;
+    }
+}
+
+#endif // CONFIG_LINE_HPP
@@ -0,0 +1,61 @@
+#ifndef CONTENT_CACHE_HPP
+#define CONTENT_CACHE_HPP
+
+#pragma once
+
+#include <compositor.hpp>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <map>
+#include <string>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+// The last text each content source published, kept in LittleFS so the display has something to show
+// right after boot, long before WiFi, NTP and the first fetch are through. Restored items are shown
+// marked as old until their source publishes again under the same id.
+// The file is rewritten only when a text changed, and at most every SAVE_INTERVAL_MS.
+class ContentCache
+{
+public:
+    static const uint32_t SAVE_INTERVAL_MS = 600000;
+
+    static ContentCache& getInstance()
+    {
+        static ContentCache instance;
+        return instance;
+    }
+
+    ContentCache(const ContentCache&) = delete;
+    ContentCache& operator=(const ContentCache&) = delete;
+
+    // publishes the item to the compositor and keeps its text, Kind::Text items only
+    void publish(const ContentItem& item);
+
+    // publishes the saved items with the time they were current, once the compositor runs
+    void restore();
+
+private:
+    ContentCache();
+
+    struct Entry
+    {
+        std::string text;
+        time_t timestamp;       // 0 when the clock was not set yet
+        uint32_t intervalMs;
+        uint8_t priority;
+    };
+
+    // writes a copy of the entries taken under the mutex, false when the file could not be opened
+    bool save(const std::vector<std::pair<std::string, Entry>>& snapshot);
+
+    SemaphoreHandle_t mutex;
+    std::map<std::string, Entry> entries;
+    bool dirty = false;
+    bool saved = false;
+    uint32_t lastSave = 0;
+};
+
+#endif // CONTENT_CACHE_HPP
@@ -1,6 +1,19 @@
 #ifndef CREATE_TASKS_H
 #define CREATE_TASKS_H
 
+#include <stdint.h>
+
+// EVENT_LOOP_MODE=1: the fetch scheduler and the status LED are driven from loop() on the
+// Arduino loop task, whose stack is allocated anyway, instead of running on tasks of their own.
+// The compositor keeps its task, it needs to block for frame timing. Fetches run synchronously
+// in loop(), so the LED stops blinking for the whole of each one.
+#ifndef EVENT_LOOP_MODE
+#define EVENT_LOOP_MODE 0
+#endif
+
 void create_tasks();
 
+// One step of the status LED blink, returns the ms until the next step is due
+uint32_t blink_led_poll();
+
 #endif // CREATE_TASKS_H
\ No newline at end of file
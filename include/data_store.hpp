@@ -2,14 +2,63 @@
 #ifndef INFOCLOCK32_INCLUDE_DATA_STORE_HPP
 #define INFOCLOCK32_INCLUDE_DATA_STORE_HPP
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
 #include <string>
 #include <LittleFS.h>
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <freertos/task.h>
+#include <metrics.hpp>
+#include <config_line.hpp>
 
+// Configuration key/value store shared by all tasks.
+//
+// Keys live in a slot table that grows a chunk of SLOTS_PER_CHUNK at a time and never shrinks or
+// moves, a Key handle resolved once with key() stays valid forever. Every value is immutable, parsed once into its typed forms when it is set,
+// and published with a single atomic pointer store. Readers never lock: they count themselves in
+// `readers`, load the pointer and read the value. Writers are serialized by a mutex. A replaced
+// value (or index) goes on a retired list and is only freed by a writer that finds no reader
+// inside, so a reader never sees freed memory and nothing leaks.
+//
+// load_from_file() keeps the text of the file and all its values in one block, three allocations
+// for the whole config instead of several per entry; the block is freed once every value in it
+// has been replaced. Key names are copied once and kept for good. Lookups by name binary search
+// an index of the slots sorted by key, which is rebuilt (and republished) whenever keys are added.
+//
+// Tasks that depend on a key subscribe() to it and wait for their event group bit instead of
+// re-reading the config in a loop. Every slot also counts its changes (generation()), for code that
+// only wants to check now and then. With startWriteBack() the values set at runtime are written
+// back to the file that was loaded, batched and debounced, through a temporary file and a rename
+// so a reset in the middle of a write never leaves a truncated config behind.
 class DataStore
 {
 public:
+    static const size_t MAX_KEYS = 512;
+    static const size_t SLOTS_PER_CHUNK = 32;           // the slot table grows by this many at a time
+    static const size_t MAX_SUBSCRIBERS = 24;           // usable bits of an event group
+    static const uint32_t WRITE_BACK_DELAY_MS = 5000;   // quiet time after the last change before saving
+    static const size_t READ_BLOCK_SIZE = 512;
+
+    // Handle of an interned key
+    class Key
+    {
+    public:
+        Key() = default;
+        bool valid() const { return slot >= 0; }
+
+    private:
+        friend class DataStore;
+        explicit Key(int16_t slot) : slot(slot) {}
+        int16_t slot = -1;
+    };
+
     static DataStore& getInstance()
     {
         static DataStore instance;
@@ -20,6 +69,10 @@ public:
     DataStore(const DataStore&) = delete;
     DataStore& operator=(const DataStore&) = delete;
 
+    // Lines are "key = value", blank lines and lines starting with '#' are skipped. Keys and values
+    // are trimmed, a value in double quotes keeps its spaces and understands \\ \" \n \t, one in single
+    // quotes is taken as is; a "#" comment may follow a quoted value. Lines may be of any length and
+    // end in LF or CRLF.
     void load_from_file(const std::string& filename)
     {
         LittleFS.begin(true);
@@ -30,67 +83,526 @@ public:
             return;
         }
 
-        auto size = file.size();
+        // The file is read in pieces into the arena and parsed where it is: keys and values are
+        // terminated and unquoted in place, only key names are copied. Counting the lines bounds the values.
+        size_t size = file.size();
+        Block* block = new Block;
+        char* arena = block->text = new char[size + 1];
+        size_t length = 0;
+        size_t lines = 1;
+        while (length < size)
+        {
+            size_t bytesRead = file.read(reinterpret_cast<uint8_t*>(arena + length), std::min(size - length, size_t(READ_BLOCK_SIZE)));
+            if (bytesRead == 0)
+                break;
+            for (size_t i = length; i < length + bytesRead; i++)
+                lines += arena[i] == '\n';
+            length += bytesRead;
+        }
+        arena[length] = '\0';
+        file.close();
+        LittleFS.end();
+
+        Value* values = static_cast<Value*>(block->values = operator new(sizeof(Value) * lines));
+        size_t used = 0;
+        size_t dropped = 0;
+        EventBits_t notify = 0;
 
-        
-        while (file.position() < size)
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        this->filename = filename;
+        char* line = arena;
+        for (size_t number = 1; line < arena + length; number++)
         {
-            char buffer[128];
-            size_t bytesRead = file.readBytesUntil('\n', buffer, sizeof(buffer) - 1);
-            buffer[bytesRead] = '\0';
-            std::string line(buffer);
-            // split into key and value separated by '=' and store in a map
-            if (line.empty())
-                continue;
-            if (line[0] == '#') // skip comments
-                continue;
+            char* lineEnd = static_cast<char*>(memchr(line, '\n', arena + length - line));
+            if (lineEnd == nullptr)
+                lineEnd = arena + length;
 
-            auto delimiterPos = line.find('=');
-            if (delimiterPos == std::string::npos)
-                continue;
+            char* key;
+            char* text;
+            const char* error = nullptr;
+            if (ConfigLine::parse_line(line, lineEnd, key, text, error))
+            {
+                int16_t slot = intern(key);
+                if (slot >= 0)
+                {
+                    block->live++;
+                    notify |= publish(slot, new (&values[used++]) Value(text, block));
+                    Serial.printf("Loaded key: %s, value: %s\n", key, text);
+                }
+                else
+                    dropped++;
+            }
+            else if (error)
+                Serial.printf("DataStore: %s line %u: %s\n", filename.c_str(), (unsigned)number, error);
 
-            std::string key = line.substr(0, delimiterPos);
-            std::string value = line.substr(delimiterPos + 1);
-            data[key] = value;
-            Serial.printf("Loaded key: %s, value: %s\n", key.c_str(), value.c_str());
+            line = lineEnd + 1;
         }
-        file.close();
-        LittleFS.end();
+        if (used == 0)
+            delete block;
+        publishIndex();
+        reclaim();
+        xSemaphoreGive(mutex);
+
+        if (notify)
+            xEventGroupSetBits(changes, notify);
+        if (dropped)
+            Serial.printf("DataStore: no slot left for %u keys\n", (unsigned)dropped);
     }
-   
+
+    // Interns the key, the handle is valid even before the key has a value.
+    // Returns an invalid handle once the slot table is full.
+    Key key(const std::string& name)
+    {
+        int16_t slot = find(name.c_str());
+        if (slot >= 0)
+            return Key(slot);
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        slot = intern(name.c_str());
+        publishIndex();
+        reclaim();
+        xSemaphoreGive(mutex);
+        return Key(slot);
+    }
+
     void set_value(const std::string& key, const std::string& value)
     {
-        data[key] = value;
+        Key handle = this->key(key);
+        if (not handle.valid())
+            Serial.printf("DataStore: no slot left for %s\n", key.c_str());
+        set_value(handle, value);
+    }
+
+    void set_value(Key key, const std::string& value)
+    {
+        if (not key.valid())
+            return;
+
+        const Value* created = Value::create(value);
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        EventBits_t notify = publish(key.slot, created);
+        reclaim();
+        xSemaphoreGive(mutex);
+
+        if (notify)
+            xEventGroupSetBits(changes, notify);
+        if (writer)
+            xTaskNotifyGive(writer);
     }
 
     std::string get_value(const std::string& key, const std::string& default_value = "")
     {
-        auto it = data.find(key);
-        if (it != data.end())
+        ReadGuard guard(*this);
+        const Value* value = lookup(find(key.c_str()));
+        return value ? value->text : default_value;
+    }
+
+    bool has_key(const std::string& key)
+    {
+        return lookup(find(key.c_str())) != nullptr;
+    }
+
+    bool has_key(Key key) const
+    {
+        return lookup(key.slot) != nullptr;
+    }
+
+    // The typed getters return the default when the key has no value or the value does not parse.
+    // None of them allocates. The text is copied out, cut to size - 1 characters; the return value
+    // is its full length, like snprintf.
+    size_t copy_value(Key key, char* buffer, size_t size, const char* default_value = "") const
+    {
+        ReadGuard guard(*this);
+        const Value* value = lookup(key.slot);
+        const char* text = value ? value->text : default_value;
+        size_t length = strlen(text);
+        if (size > 0)
         {
-            return it->second;
+            size_t copied = std::min(length, size - 1);
+            memcpy(buffer, text, copied);
+            buffer[copied] = '\0';
         }
-        return default_value;
+        return length;
     }
 
-    bool has_key(const std::string& key)
+    long get_int(Key key, long default_value = 0) const
+    {
+        ReadGuard guard(*this);
+        const Value* value = lookup(key.slot);
+        return value && value->isInt ? value->asInt : default_value;
+    }
+
+    float get_float(Key key, float default_value = 0.0f) const
     {
-        return data.find(key) != data.end();
+        ReadGuard guard(*this);
+        const Value* value = lookup(key.slot);
+        return value && value->isFloat ? value->asFloat : default_value;
     }
 
+    // 1/0, true/false, yes/no, on/off
+    bool get_bool(Key key, bool default_value = false) const
+    {
+        ReadGuard guard(*this);
+        const Value* value = lookup(key.slot);
+        return value && value->isBool ? value->asBool : default_value;
+    }
+
+    // drops all values, the keys and their handles stay. Not written back, the file keeps its values.
     void clear()
     {
-        data.clear();
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        EventBits_t notify = 0;
+        for (size_t i = 0; i < slot_count.load(std::memory_order_relaxed); i++)
+            notify |= publish(i, nullptr);
+        reclaim();
+        xSemaphoreGive(mutex);
+
+        if (notify)
+            xEventGroupSetBits(changes, notify);
+    }
+
+    // Returns the bit that is set in the change event group whenever one of the keys gets a new
+    // value, 0 once all MAX_SUBSCRIBERS bits are taken. The bit stays set until it is waited for.
+    EventBits_t subscribe(std::initializer_list<Key> keys)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        EventBits_t bit = 0;
+        if (subscriber_count < MAX_SUBSCRIBERS)
+        {
+            bit = EventBits_t(1) << subscriber_count++;
+            for (Key key : keys)
+                if (key.valid())
+                    slotAt(key.slot).subscribers |= bit;
+        }
+        xSemaphoreGive(mutex);
+
+        if (bit == 0)
+            Serial.println("DataStore: no subscriber bit left");
+        return bit;
+    }
+
+    // true when a subscribed key changed within the timeout, clears the bit
+    bool wait_for_change(EventBits_t bit, TickType_t timeout = portMAX_DELAY)
+    {
+        if (bit == 0)
+        {
+            vTaskDelay(timeout);
+            return false;
+        }
+        return (xEventGroupWaitBits(changes, bit, pdTRUE, pdFALSE, timeout) & bit) != 0;
+    }
+
+    // counts the changes of the key, compare with an earlier value to see whether it changed since
+    uint32_t generation(Key key) const
+    {
+        return key.valid() ? slotAt(key.slot).generation.load(std::memory_order_acquire) : 0;
+    }
+
+    // Starts the task that writes set_value() changes back to the loaded file, delayMs after the
+    // last one. Comments in the file are not kept.
+    void startWriteBack(uint32_t delayMs = WRITE_BACK_DELAY_MS)
+    {
+        if (writer != nullptr)
+            return;
+
+        writeBackDelayMs = delayMs;
+        xTaskCreate(write_back_task_function, "DataStoreWriteBack", 3072, this, 1, &writer);
+        Metrics::getInstance().addTask(writer, 3072);
     }
 
 private:
+    struct Block;
+
+    // parsed once when set, never changed afterwards
+    struct Value
+    {
+        Value(const char* text, Block* block) : text(text), block(block)
+        {
+            char* end = nullptr;
+
+            asInt = strtol(text, &end, 0);
+            isInt = *text != '\0' && *end == '\0';
+
+            asFloat = strtof(text, &end);
+            isFloat = *text != '\0' && *end == '\0';
+
+            isBool = true;
+            if (strcasecmp(text, "1") == 0 || strcasecmp(text, "true") == 0 || strcasecmp(text, "yes") == 0 || strcasecmp(text, "on") == 0)
+                asBool = true;
+            else if (strcasecmp(text, "0") == 0 || strcasecmp(text, "false") == 0 || strcasecmp(text, "no") == 0 || strcasecmp(text, "off") == 0)
+                asBool = false;
+            else
+                isBool = false;
+        }
+
+        // a value set at runtime, in a block of its own with the text right behind it
+        static const Value* create(const std::string& text)
+        {
+            Block* block = new Block;
+            block->values = operator new(sizeof(Value) + text.size() + 1);
+            block->live = 1;
+            char* copy = static_cast<char*>(block->values) + sizeof(Value);
+            memcpy(copy, text.c_str(), text.size() + 1);
+            return new (block->values) Value(copy, block);
+        }
+
+        const char* text;
+        Block* block;           // the memory it lives in
+        long asInt;
+        float asFloat;
+        bool asBool;
+        bool isInt;
+        bool isFloat;
+        bool isBool;
+    };
+
+    // Memory of one value set at runtime, or of all values of a loaded file and the text they point into.
+    // Values are trivially destructible, freeing the memory is all there is to it.
+    struct Block
+    {
+        size_t live = 0;            // values in it that are still published, with the mutex held
+        char* text = nullptr;       // the file of a load
+        void* values = nullptr;     // the Value array of a load, or one Value and its text
+        Block* next = nullptr;      // retired list
+
+        ~Block()
+        {
+            delete[] text;
+            operator delete(values);
+        }
+    };
+
+    struct Slot
+    {
+        const char* name = nullptr;             // written once before the slot is published
+        std::atomic<const Value*> value{nullptr};
+        std::atomic<uint32_t> generation{0};
+        EventBits_t subscribers = 0;            // with the mutex held
+    };
+
+    // slots ordered by name
+    struct Index
+    {
+        size_t count;
+        Index* next;                // retired list
+        int16_t* slots;             // count entries, right behind the struct in the same allocation
+
+        static Index* create(size_t count)
+        {
+            Index* index = new (operator new(sizeof(Index) + count * sizeof(int16_t))) Index{count, nullptr, nullptr};
+            index->slots = reinterpret_cast<int16_t*>(index + 1);
+            return index;
+        }
+    };
+
+    // Held by every reader while it uses a value or the index it loaded, see reclaim().
+    // The counter and the pointers use sequentially consistent ordering: a reader that comes in
+    // after a writer found the count at 0 is guaranteed to load the new pointers.
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(const DataStore& store) : readers(store.readers) { readers.fetch_add(1); }
+        ~ReadGuard() { readers.fetch_sub(1); }
+
+    private:
+        std::atomic<uint32_t>& readers;
+    };
+
     DataStore()
     {
-        // load data from persistent storage if needed
-        // from SPIFFS   
+        mutex = xSemaphoreCreateMutex();
+        changes = xEventGroupCreate();
+        index.store(Index::create(0));
     }
     ~DataStore() = default;
 
-    std::map<std::string, std::string> data;
+    // lock free binary search in the published index
+    int16_t find(const char* name) const
+    {
+        ReadGuard guard(*this);
+        const Index* current = index.load();
+        size_t low = 0;
+        size_t high = current->count;
+        while (low < high)
+        {
+            size_t middle = (low + high) / 2;
+            int16_t slot = current->slots[middle];
+            int order = strcmp(slotAt(slot).name, name);
+            if (order == 0)
+                return slot;
+            if (order < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return -1;
+    }
+
+    // with the mutex held, publishIndex() makes new keys visible to find().
+    // The name is copied, keys are never removed so the copies are never freed.
+    int16_t intern(const char* name)
+    {
+        int16_t found = find(name);
+        if (found >= 0)
+            return found;
+
+        //only the keys added since the index was built need a look
+        size_t count = slot_count.load(std::memory_order_relaxed);
+        for (size_t i = index.load(std::memory_order_relaxed)->count; i < count; i++)
+            if (strcmp(slotAt(i).name, name) == 0)
+                return i;
+
+        if (count == MAX_KEYS)
+            return -1;
+
+        if (count % SLOTS_PER_CHUNK == 0)
+            chunks[count / SLOTS_PER_CHUNK] = new Slot[SLOTS_PER_CHUNK];
+        size_t length = strlen(name) + 1;
+        char* copy = new char[length];
+        memcpy(copy, name, length);
+        slotAt(count).name = copy;
+        slot_count.store(count + 1, std::memory_order_release);
+        return count;
+    }
+
+    // with the mutex held. The replaced index is retired, a reader may still be searching it.
+    void publishIndex()
+    {
+        size_t count = slot_count.load(std::memory_order_relaxed);
+        Index* current = index.load(std::memory_order_relaxed);
+        if (current->count == count)
+            return;
+
+        Index* next = Index::create(count);
+        for (size_t i = 0; i < count; i++)
+            next->slots[i] = i;
+        std::sort(next->slots, next->slots + count,
+            [this](int16_t a, int16_t b) { return strcmp(slotAt(a).name, slotAt(b).name) < 0; });
+        index.store(next);
+
+        current->next = retired_indexes;
+        retired_indexes = current;
+    }
+
+    // with the mutex held, returns the subscriber bits to set once it is released.
+    // The block of the replaced value is retired once none of its values is published any more.
+    EventBits_t publish(int16_t slot, const Value* value)
+    {
+        const Value* replaced = slotAt(slot).value.exchange(value);
+        slotAt(slot).generation.fetch_add(1, std::memory_order_release);
+        if (replaced && --replaced->block->live == 0)
+        {
+            replaced->block->next = retired_blocks;
+            retired_blocks = replaced->block;
+        }
+        return slotAt(slot).subscribers;
+    }
+
+    // With the mutex held. Frees what was replaced, unless a reader is inside: it may still
+    // hold a pointer into it. What stays on the lists goes with a later write or save.
+    void reclaim()
+    {
+        if ((retired_blocks == nullptr && retired_indexes == nullptr) || readers.load() != 0)
+            return;
+
+        while (retired_blocks)
+        {
+            Block* block = retired_blocks;
+            retired_blocks = block->next;
+            delete block;
+        }
+        while (retired_indexes)
+        {
+            Index* retired = retired_indexes;
+            retired_indexes = retired->next;
+            operator delete(retired);
+        }
+    }
+
+    // writes all values to "<file>.tmp" and renames it over the file
+    void save()
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        std::string target = filename;
+        xSemaphoreGive(mutex);
+
+        if (target.empty())
+            return;
+
+        std::string temporary = target + ".tmp";
+        LittleFS.begin(true);
+        File file = LittleFS.open(temporary.c_str(), "w");
+        if (!file) {
+            Serial.printf("DataStore: cannot open %s for writing\n", temporary.c_str());
+            return;
+        }
+
+        bool ok = true;
+        size_t saved = 0;
+        {
+            ReadGuard guard(*this);
+            for (size_t i = 0; i < slot_count.load(std::memory_order_acquire); i++)
+            {
+                const Value* value = lookup(i);
+                if (value == nullptr)
+                    continue;
+                ok = ok && file.printf("%s=", slotAt(i).name) == strlen(slotAt(i).name) + 1
+                    && ConfigLine::write_value(file, value->text) && file.write('\n') == 1;
+                saved++;
+            }
+        }
+        file.close();
+
+        if (ok && LittleFS.rename(temporary.c_str(), target.c_str()))
+            Serial.printf("DataStore: saved %u keys to %s\n", (unsigned)saved, target.c_str());
+        else
+        {
+            Serial.printf("DataStore: writing %s failed\n", target.c_str());
+            LittleFS.remove(temporary.c_str());
+        }
+    }
+
+    static void write_back_task_function(void* parameter)
+    {
+        DataStore* store = static_cast<DataStore*>(parameter);
+        while (true)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            //every further change restarts the delay, a burst of changes is saved once
+            while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(store->writeBackDelayMs)) > 0)
+                ;
+            store->save();
+
+            //values replaced while a reader was inside are still waiting
+            xSemaphoreTake(store->mutex, portMAX_DELAY);
+            store->reclaim();
+            xSemaphoreGive(store->mutex);
+        }
+    }
+
+    // with a ReadGuard held when the value is used, not only compared
+    const Value* lookup(int16_t slot) const
+    {
+        return slot >= 0 ? slotAt(slot).value.load() : nullptr;
+    }
+
+    // chunks are allocated with the mutex held before the slot is handed out, and never freed
+    Slot& slotAt(size_t slot) const
+    {
+        return chunks[slot / SLOTS_PER_CHUNK][slot % SLOTS_PER_CHUNK];
+    }
+
+    SemaphoreHandle_t mutex;
+    Slot* chunks[MAX_KEYS / SLOTS_PER_CHUNK] = {};
+    std::atomic<size_t> slot_count{0};
+    std::atomic<Index*> index{nullptr};
+    mutable std::atomic<uint32_t> readers{0};   // inside a ReadGuard
+    Block* retired_blocks = nullptr;            // with the mutex held, freed by reclaim()
+    Index* retired_indexes = nullptr;
+    EventGroupHandle_t changes;
+    size_t subscriber_count = 0;
+    std::string filename;                       // last loaded, written back to
+    TaskHandle_t writer = nullptr;
+    uint32_t writeBackDelayMs = WRITE_BACK_DELAY_MS;
 };
-#endif // INFOCLOCK32_INCLUDE_DATA_STORE_HPP
\ No newline at end of file
+#endif // INFOCLOCK32_INCLUDE_DATA_STORE_HPP
@@ -0,0 +1,99 @@
+#ifndef FETCH_SCHEDULER_HPP
+#define FETCH_SCHEDULER_HPP
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// A content source the scheduler fetches periodically. The callback does the request
+// (it knows its URL, credentials and parser), publishes the result and returns false on failure.
+struct FetchSource
+{
+    std::string name;
+    std::function<bool()> fetch;
+
+    uint32_t intervalMs = 60000;        // between two successful fetches
+    uint32_t jitterMs = 0;              // random extra delay, keeps sources from lining up
+    uint32_t retryMs = 60000;           // first retry after a failure, doubled on every further failure
+    uint32_t maxBackoffMs = 900000;     // the retry delay never grows past this
+    size_t heapNeeded = 0;              // free heap the fetch needs (TLS, inflate), it waits until that is there
+};
+
+// Runs the fetches of all registered sources one at a time on a single worker task,
+// so they never overlap and never compete for WiFi and TLS memory.
+// Sources are kept in a min-heap ordered by due time.
+class FetchScheduler
+{
+public:
+    // waited before a fetch is tried again when the heap is short
+    static const uint32_t HEAP_RETRY_MS = 5000;
+
+    struct Status
+    {
+        std::string name;
+        int32_t nextDueMs;          // negative when overdue or running
+        uint32_t runs;
+        uint32_t failures;          // in a row, drives the backoff
+        uint32_t totalFailures;
+        uint32_t heapDeferrals;     // times it waited for free heap
+        uint32_t lastDurationMs;
+    };
+
+    static FetchScheduler& getInstance()
+    {
+        static FetchScheduler instance;
+        return instance;
+    }
+
+    FetchScheduler(const FetchScheduler&) = delete;
+    FetchScheduler& operator=(const FetchScheduler&) = delete;
+
+    // starts the worker task, or with runOnCaller the fetches run from poll() on the calling task
+    void begin(bool runOnCaller = false);
+
+    // runs one fetch if one is due, returns the ms until the next one is due (UINT32_MAX when none is
+    // or before begin())
+    uint32_t poll();
+
+    // the first fetch is due right away
+    void add(const FetchSource& source);
+
+    // makes a source due now, a source that is already due or running is fetched only once more
+    void fetchNow(const std::string& name);
+
+    std::vector<Status> getStatus();
+
+private:
+    FetchScheduler();
+
+    struct Entry
+    {
+        FetchSource source;
+        TickType_t due;
+        bool running;
+        bool rerun;
+        Status status;
+    };
+
+    static void scheduler_task_function(void* parameter);
+
+    bool later(size_t a, size_t b) const;
+    void push(size_t index);
+    void reschedule();
+    bool waitForHeap(Entry& entry);
+    void run(size_t index);
+
+    SemaphoreHandle_t mutex;
+    std::vector<Entry> entries;
+    std::vector<size_t> heap;       // entry indexes, the next due on top
+    TaskHandle_t task = nullptr;
+    bool started = false;
+};
+
+#endif // FETCH_SCHEDULER_HPP
@@ -0,0 +1,35 @@
+#ifndef FRAME_MIRROR_HPP
+#define FRAME_MIRROR_HPP
+
+#include <Arduino.h>
+
+// Binary mirror of the LED matrix frames, replaces the ASCII dump of displayToSerial in the render loops.
+// Frames are queued by the render path and written to the output by a low priority task,
+// only the latest frame is kept so a slow host never blocks rendering (skipped frames show up as gaps in the counter).
+//
+// Packet layout (multi-byte values little endian), decoded by tools/frame_mirror_decode.py:
+//   0xA5 0x5A      sync
+//   u8             encoding: 0 = raw columns, 1 = RLE (count, value) pairs
+//   u16            frame counter
+//   u16            number of columns
+//   u16            payload length
+//   payload        column bytes, bit 0 is the top row
+//   u8             XOR of all payload bytes
+namespace FrameMirror
+{
+
+static const uint8_t SYNC_0 = 0xA5;
+static const uint8_t SYNC_1 = 0x5A;
+static const uint8_t ENCODING_RAW = 0;
+static const uint8_t ENCODING_RLE = 1;
+static const uint16_t MAX_COLUMNS = 256;
+
+void begin(Print& out, bool rle = true);
+
+// frameBuffer is the packed LEDMatrixDriver buffer (8 rows of `segments` bytes),
+// frames identical to the previous one are not sent
+void publish(const uint8_t* frameBuffer, uint8_t segments);
+
+}
+
+#endif // FRAME_MIRROR_HPP
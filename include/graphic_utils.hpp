@@ -5,10 +5,17 @@
 
 #include <Adafruit_GFX.h>
 #include <LMDS.hpp>
+#include <strip_cache.hpp>
+#include <functional>
 
 void copyCanvasToDisplay(GFXcanvas1 &canvas, uint16_t canvasOffset, LMDS &display, uint16_t displayOffset = 0);
+void copyStripToDisplay(const uint8_t *columns, int stripWidth, int stripOffset, LMDS &display, int16_t displayOffset = 0);
 void scrollMessage(std::string message, LMDS& display, int speed = 100, int step = 6);
 
+// centers the strip if it fits, scrolls it otherwise; stop() can end the scroll early
+void showStrip(const MessageStrip& strip, LMDS& display, int speed = 100, int step = 6,
+               const std::function<bool()>& stop = nullptr);
+
 
 void wipeDisplayLeftToRight(LMDS& display, int speed = 50);
 void scrollOutDisplayRight(LMDS& display, int speed = 50);
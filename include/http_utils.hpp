@@ -2,11 +2,106 @@
 #define HTTP_UTILS_HPP
 
 #include <Arduino.h>
+#include <HTTPClient.h>
 
-namespace HttpUtils 
+#include <algorithm>
+
+namespace HttpUtils
+{
+
+// Receives a response piece by piece, see httpGetStream()
+class HttpSink
+{
+public:
+    virtual ~HttpSink() {}
+
+    // Called once the status line and headers are in, before any body data.
+    // contentLength is -1 when the server did not send one (chunked or close-delimited body).
+    // Return false to skip the body.
+    virtual bool onResponse(int status, int contentLength, HTTPClient& http)
+    {
+        return status == HTTP_CODE_OK;
+    }
+
+    // Called for every piece of the body, return false to abort: the rest is not read,
+    // the connection is closed and the response does not count as complete
+    virtual bool onData(const uint8_t* data, size_t len) = 0;
+
+    // True once the sink has all it wants. The rest of the body is then still read, without
+    // calling onData, so the response counts as complete and the connection can be reused
+    virtual bool satisfied() const
+    {
+        return false;
+    }
+};
+
+// For callers to return when a 200 response did not contain what they parse out of it,
+// clear of the HTTPC_ERROR_* codes of HTTPClient
+static const int HTTP_ERROR_INCOMPLETE_BODY = -100;
+
+// Size of the buffer the body is read through, it lives on the caller's stack
+static const size_t STREAM_BUFFER_SIZE = 512;
+
+// Connections are kept open per scheme://host:port and reused by the next request to
+// the same origin. An idle TLS connection holds on to tens of KB of heap, so only a few
+// are kept and they are closed once idle for longer than POOL_IDLE_TIMEOUT_MS.
+static const size_t POOL_SIZE = 2;
+static const uint32_t POOL_IDLE_TIMEOUT_MS = 60000;
+
+// ETag / Last-Modified of the last complete responses are written to flash at most this often
+static const uint32_t VALIDATOR_SAVE_INTERVAL_MS = 600000;
+
+struct HttpLatency
+{
+    uint32_t count = 0;
+    uint32_t minMs = UINT32_MAX;
+    uint32_t maxMs = 0;
+    uint64_t totalMs = 0;
+
+    uint32_t averageMs() const { return count ? totalMs / count : 0; }
+
+    void add(uint32_t ms)
+    {
+        count++;
+        minMs = std::min(minMs, ms);
+        maxMs = std::max(maxMs, ms);
+        totalMs += ms;
+    }
+};
+
+struct HttpStats
 {
-    
-int httpGet(const String &url, String &outBody, bool insecure = true);
+    uint32_t requests = 0;
+    uint32_t handshakesAvoided = 0;     // requests sent on a connection that was still open
+    uint32_t connects = 0;              // requests that had to open a connection (and do the TLS handshake)
+    uint32_t retries = 0;               // reused connections the server had closed in the meantime
+    uint32_t errors = 0;
+    uint32_t compressedResponses = 0;   // gzip or deflate bodies
+    uint64_t compressedBytes = 0;       // of those bodies as received
+    uint64_t decompressedBytes = 0;     // of those bodies as passed to the sinks
+    HttpLatency reused;                 // request to end of body, on a kept-alive connection
+    HttpLatency fresh;                  // request to end of body, including connect and handshake
+};
+
+int httpGet(const String &url, String &outBody, bool insecure = true, bool conditional = false);
+
+// Performs a GET and hands the body to the sink through a fixed size buffer,
+// the body is never held in memory as a whole. Headers listed in headerKeys
+// can be read with http.header() in onResponse().
+// Requests are serialized, the connection is taken from the pool. gzip and deflate are
+// accepted and decompressed before the sink sees the body.
+// A conditional request sends If-None-Match / If-Modified-Since from the last complete
+// response for the same url and returns HTTP_CODE_NOT_MODIFIED, without calling the sink,
+// when nothing changed. Only ask for it while still holding the result of that response.
+// Returns the HTTP status code or a negative HTTPC_ERROR_* value.
+int httpGetStream(const String &url, HttpSink &sink, bool insecure = true,
+                  const char *headerKeys[] = nullptr, size_t headerCount = 0,
+                  bool conditional = false);
+
+HttpStats getStats();
+
+// Closes all pooled connections, e.g. to give their heap back
+void closeConnections();
 
 }
-#endif // HTTP_UTILS_HPP
\ No newline at end of file
+#endif // HTTP_UTILS_HPP
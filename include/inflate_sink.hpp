@@ -0,0 +1,206 @@
+#ifndef INFLATE_SINK_HPP
+#define INFLATE_SINK_HPP
+
+#pragma once
+
+#include <http_utils.hpp>
+#include <rom/miniz.h>
+
+#include <cstdlib>
+
+namespace HttpUtils
+{
+
+// Decompresses a gzip or deflate (zlib) body on the fly and passes the output on to another sink,
+// using the inflater in ROM. Deflate needs the last 32 KB of output as dictionary, that and the
+// decompressor state (~11 KB) are only allocated while a compressed response is read.
+class InflateSink : public HttpSink
+{
+public:
+    InflateSink(HttpSink &target, bool gzip)
+        : target(target), state(gzip ? State::GzipHeader : State::Body),
+          flags(TINFL_FLAG_HAS_MORE_INPUT | (gzip ? 0 : TINFL_FLAG_PARSE_ZLIB_HEADER))
+    {
+        decompressor = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+        dictionary = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+        if (decompressor)
+            tinfl_init(decompressor);
+    }
+
+    ~InflateSink()
+    {
+        free(decompressor);
+        free(dictionary);
+    }
+
+    InflateSink(const InflateSink&) = delete;
+    InflateSink& operator=(const InflateSink&) = delete;
+
+    bool failed() const { return error; }
+
+    // The result of the response once the body is read: HTTPC_ERROR_ENCODING when the stream was
+    // corrupt, or ended before its last block while the target still wanted more
+    int result(int httpCode) const
+    {
+        if (error || (state != State::Done && not aborted && not target.satisfied()))
+            return HTTPC_ERROR_ENCODING;
+        return httpCode;
+    }
+
+    // nothing is decompressed any more once the target is satisfied
+    bool satisfied() const override { return target.satisfied(); }
+    size_t compressedBytes() const { return compressed; }
+    size_t decompressedBytes() const { return decompressed; }
+
+    bool onData(const uint8_t *data, size_t len) override
+    {
+        compressed += len;
+        if (decompressor == nullptr || dictionary == nullptr)
+            return fail();
+
+        for (; len > 0 && state != State::Body && state != State::Done; data++, len--)
+            if (not parseGzipHeader(*data))
+                return fail();
+
+        // the gzip trailer (CRC32 and size) is read but not checked, TCP/TLS already did
+        if (state == State::Done || len == 0)
+            return true;
+
+        while (true) {
+            size_t inSize = len;
+            size_t outSize = TINFL_LZ_DICT_SIZE - dictionaryOffset;
+            tinfl_status status = tinfl_decompress(decompressor, data, &inSize, dictionary,
+                                                   dictionary + dictionaryOffset, &outSize, flags);
+            data += inSize;
+            len -= inSize;
+
+            if (outSize > 0) {
+                decompressed += outSize;
+                bool more = target.onData(dictionary + dictionaryOffset, outSize);
+                dictionaryOffset = (dictionaryOffset + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+                if (not more) {
+                    aborted = true;
+                    return false;
+                }
+            }
+
+            if (status < TINFL_STATUS_DONE)
+                return fail();
+            if (status == TINFL_STATUS_DONE) {
+                state = State::Done;
+                return true;
+            }
+            if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0)
+                return true;
+        }
+    }
+
+private:
+    enum class State { GzipHeader, ExtraLength, Extra, Name, Comment, HeaderCrc, Body, Done };
+
+    static const uint8_t FHCRC = 0x02, FEXTRA = 0x04, FNAME = 0x08, FCOMMENT = 0x10;
+
+    // 10 byte header, then the optional fields the flags announce
+    bool parseGzipHeader(uint8_t c)
+    {
+        switch (state) {
+            case State::GzipHeader:
+                if ((headerPos == 0 && c != 0x1f) || (headerPos == 1 && c != 0x8b) || (headerPos == 2 && c != 8))
+                    return false;
+                if (headerPos == 3)
+                    gzipFlags = c;
+                if (++headerPos == 10)
+                    nextHeaderField();
+                return true;
+
+            case State::ExtraLength:
+                extraLength |= size_t(c) << (8 * (2 - remaining));
+                if (--remaining == 0) {
+                    remaining = extraLength;
+                    state = State::Extra;
+                    if (remaining == 0)
+                        nextHeaderField();
+                }
+                return true;
+
+            case State::Extra:
+            case State::HeaderCrc:
+                if (--remaining == 0)
+                    nextHeaderField();
+                return true;
+
+            case State::Name:
+            case State::Comment:
+                if (c == 0)
+                    nextHeaderField();
+                return true;
+
+            default:
+                return true;
+        }
+    }
+
+    // moves on to the next optional field the flags announce, in the order of the spec
+    void nextHeaderField()
+    {
+        while (true) {
+            switch (state) {
+                case State::GzipHeader:
+                    state = State::ExtraLength;
+                    remaining = 2;
+                    extraLength = 0;
+                    if (gzipFlags & FEXTRA)
+                        return;
+                    break;
+                case State::ExtraLength:
+                case State::Extra:
+                    state = State::Name;
+                    if (gzipFlags & FNAME)
+                        return;
+                    break;
+                case State::Name:
+                    state = State::Comment;
+                    if (gzipFlags & FCOMMENT)
+                        return;
+                    break;
+                case State::Comment:
+                    state = State::HeaderCrc;
+                    remaining = 2;
+                    if (gzipFlags & FHCRC)
+                        return;
+                    break;
+                default:
+                    state = State::Body;
+                    return;
+            }
+        }
+    }
+
+    bool fail()
+    {
+        error = true;
+        return false;
+    }
+
+    HttpSink &target;
+    State state;
+    const mz_uint32 flags;
+
+    tinfl_decompressor *decompressor = nullptr;
+    uint8_t *dictionary = nullptr;
+    size_t dictionaryOffset = 0;
+
+    uint8_t headerPos = 0;
+    uint8_t gzipFlags = 0;
+    size_t remaining = 0;
+    size_t extraLength = 0;
+
+    size_t compressed = 0;
+    size_t decompressed = 0;
+    bool error = false;
+    bool aborted = false;       // by the target
+};
+
+}
+
+#endif // INFLATE_SINK_HPP
@@ -0,0 +1,289 @@
+#ifndef JSON_PATH_MATCHER_HPP
+#define JSON_PATH_MATCHER_HPP
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// One node of the trie of wanted paths. The root of the document is parent -1,
+// a node either names an object member (key) or an array element (key == nullptr, index).
+// Leaves have a slot the scalar value is captured into, inner nodes have slot -1.
+//
+// The table for /list/2/main/temp and /city/name:
+//   { -1, "list", 0, -1 },     // 0
+//   {  0, nullptr, 2, -1 },    // 1  list[2]
+//   {  1, "main", 0, -1 },     // 2
+//   {  2, "temp", 0, 0 },      // 3  -> slot 0
+//   { -1, "city", 0, -1 },     // 4
+//   {  4, "name", 0, 1 },      // 5  -> slot 1
+struct JsonPathNode
+{
+    int8_t parent;
+    const char* key;
+    int16_t index;
+    int8_t slot;
+};
+
+namespace JsonPath
+{
+    constexpr size_t countSlots(const JsonPathNode* nodes, size_t count)
+    {
+        return count == 0 ? 0 : (nodes[0].slot >= 0 ? 1 : 0) + countSlots(nodes + 1, count - 1);
+    }
+
+    // Number of values a table captures, to size the matcher at compile time
+    template <size_t N>
+    constexpr size_t slotCount(const JsonPathNode (&nodes)[N])
+    {
+        return countSlots(nodes, N);
+    }
+}
+
+// Streaming JSON matcher that captures the scalar values at the paths of a JsonPathNode table.
+// The current position is a trie node instead of a path string: containers that are not on a
+// wanted path are skipped as a whole by counting brackets, and keys are only compared against
+// the children of the current node. Nothing is allocated, values are kept in fixed buffers and
+// cut at VALUE_SIZE - 1 characters. Escapes keep the escaped character, \uXXXX is not decoded.
+// Malformed input is not reported, it just captures less.
+template <size_t SLOTS, size_t VALUE_SIZE = 48>
+class JsonPathMatcher
+{
+public:
+    static const size_t MAX_DEPTH = 16;
+
+    JsonPathMatcher(const JsonPathNode* nodes, size_t nodeCount)
+        : nodes(nodes), node_count(nodeCount)
+    {
+        static_assert(SLOTS < 32, "captured slots are tracked in a 32 bit mask");
+        for (auto& value : values)
+            value[0] = '\0';
+    }
+
+    template <size_t N>
+    JsonPathMatcher(const JsonPathNode (&nodes)[N]) : JsonPathMatcher(nodes, N) {}
+
+    // Input after done() is ignored, the caller may still read the rest of the document and pass it in
+    void feed(const uint8_t* data, size_t len)
+    {
+        for (size_t i = 0; i < len && not done(); i++)
+            parse(char(data[i]));
+    }
+
+    bool complete() const { return captured == (1u << SLOTS) - 1; }
+    bool done() const { return complete() || finished; }
+
+    bool has(size_t slot) const { return captured & (1u << slot); }
+    const char* value(size_t slot) const { return values[slot]; }
+
+private:
+    static const int16_t ROOT = -1;
+    static const int16_t UNWANTED = -2;
+
+    struct Frame
+    {
+        int16_t node;
+        bool array;
+        uint16_t index;
+    };
+
+    int16_t child(int16_t parent, const char* key, uint16_t index) const
+    {
+        if (parent == UNWANTED)
+            return UNWANTED;
+
+        for (size_t i = 0; i < node_count; i++)
+        {
+            const JsonPathNode& node = nodes[i];
+            if (node.parent != parent)
+                continue;
+            if (key ? (node.key && strcmp(node.key, key) == 0) : (not node.key && node.index == index))
+                return int16_t(i);
+        }
+        return UNWANTED;
+    }
+
+    int8_t slotOf(int16_t node) const
+    {
+        return node >= 0 ? nodes[node].slot : -1;
+    }
+
+    void parse(char c)
+    {
+        if (in_string)
+        {
+            parseString(c);
+            return;
+        }
+
+        if (skip_depth > 0)
+        {
+            if (c == '"')
+                in_string = true;
+            else if (c == '{' || c == '[')
+                skip_depth++;
+            else if (c == '}' || c == ']')
+                skip_depth--;
+            return;
+        }
+
+        if (in_literal && (c == ',' || c == '}' || c == ']' || isSpace(c)))
+            endValue();
+
+        switch (c)
+        {
+            case '"':
+                in_string = true;
+                escape = false;
+                if (expect_key)
+                    key_length = 0;
+                else
+                    beginValue();
+                break;
+
+            case '{':
+            case '[':
+                if (pending == UNWANTED || depth == MAX_DEPTH)
+                {
+                    skip_depth = 1;
+                    break;
+                }
+                stack[depth++] = Frame{pending, c == '[', 0};
+                if (c == '[')
+                    pending = child(pending, nullptr, 0);
+                else
+                    expect_key = true;
+                break;
+
+            case '}':
+            case ']':
+                expect_key = false;
+                if (depth > 0)
+                    depth--;
+                if (depth == 0)
+                    finished = true;
+                break;
+
+            case ',':
+                if (depth == 0)
+                    break;
+                if (stack[depth - 1].array)
+                {
+                    Frame& frame = stack[depth - 1];
+                    frame.index++;
+                    pending = child(frame.node, nullptr, frame.index);
+                }
+                else
+                    expect_key = true;
+                break;
+
+            case ':':
+                break;
+
+            default:
+                if (not isSpace(c) && not in_literal)
+                {
+                    in_literal = true;
+                    beginValue();
+                }
+                if (in_literal)
+                    append(c);
+                break;
+        }
+    }
+
+    void parseString(char c)
+    {
+        if (escape)
+            escape = false;
+        else if (c == '\\')
+        {
+            escape = true;
+            return;
+        }
+        else if (c == '"')
+        {
+            in_string = false;
+            if (skip_depth > 0)
+                return;
+
+            if (expect_key)
+            {
+                key[key_length] = '\0';
+                expect_key = false;
+                pending = key_overflow ? UNWANTED : child(depth ? stack[depth - 1].node : ROOT, key, 0);
+                key_overflow = false;
+            }
+            else
+                endValue();
+            return;
+        }
+
+        if (skip_depth > 0)
+            return;
+
+        if (expect_key)
+        {
+            if (key_length < sizeof(key) - 1)
+                key[key_length++] = c;
+            else
+                key_overflow = true;
+        }
+        else
+            append(c);
+    }
+
+    void beginValue()
+    {
+        capture = slotOf(pending);
+        value_length = 0;
+    }
+
+    void append(char c)
+    {
+        if (capture >= 0 && value_length < VALUE_SIZE - 1)
+            values[capture][value_length++] = c;
+    }
+
+    void endValue()
+    {
+        in_literal = false;
+        if (capture >= 0)
+        {
+            values[capture][value_length] = '\0';
+            captured |= 1u << capture;
+        }
+        capture = -1;
+    }
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    const JsonPathNode* nodes;
+    size_t node_count;
+
+    Frame stack[MAX_DEPTH];
+    size_t depth = 0;
+    size_t skip_depth = 0;      // nesting inside a container nobody wants
+    int16_t pending = ROOT;     // node of the value that comes next
+
+    bool in_string = false;
+    bool escape = false;
+    bool in_literal = false;
+    bool expect_key = false;
+    bool finished = false;
+
+    char key[32];
+    size_t key_length = 0;
+    bool key_overflow = false;
+
+    int8_t capture = -1;        // slot the current value goes to
+    size_t value_length = 0;
+    uint32_t captured = 0;
+    char values[SLOTS][VALUE_SIZE];
+};
+
+#endif // JSON_PATH_MATCHER_HPP
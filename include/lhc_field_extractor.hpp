@@ -0,0 +1,191 @@
+#ifndef LHC_FIELD_EXTRACTOR_HPP
+#define LHC_FIELD_EXTRACTOR_HPP
+
+#pragma once
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Picks <title>Key: value</title> of the interesting keys out of the RSS while it streams in,
+// byte by byte into fixed buffers. Parsing stops as soon as all of them are found,
+// the rest of the body is only drained. Nothing is allocated.
+// The clock (microseconds, esp_timer_get_time on the board) times the parsing for the metrics.
+class LhcFieldExtractor
+{
+public:
+    enum Field { LhcPage1, LhcBeamMode, BeamEnergy, LhcMachineMode, FIELD_COUNT };
+
+    explicit LhcFieldExtractor(int64_t (*clock)()) : clock(clock)
+    {
+        static const char* const keys[FIELD_COUNT] = { "LhcPage1", "LhcBeamMode", "BeamEnergy", "LhcMachineMode" };
+        for (int i = 0; i < FIELD_COUNT; i++)
+        {
+            slots[i].key = keys[i];
+            slots[i].value[0] = '\0';
+            slots[i].found = false;
+        }
+    }
+
+    const char* key(Field field) const { return slots[field].key; }
+    const char* value(Field field) const { return slots[field].value; }
+    bool found(Field field) const { return slots[field].found; }
+    int foundCount() const { return found_count; }
+    uint32_t parseTimeUs() const { return parse_time_us; }
+
+    // Input after satisfied() is ignored, the caller may still pass in the rest of the body
+    void feed(const uint8_t* data, size_t len)
+    {
+        int64_t start = clock();
+        for (size_t i = 0; i < len && not satisfied(); i++)
+            consume(char(data[i]));
+        parse_time_us += clock() - start;
+    }
+
+    bool satisfied() const
+    {
+        return found_count == FIELD_COUNT;
+    }
+
+private:
+    enum class State { Search, Key, Value, Tag };
+
+    struct Slot
+    {
+        const char* key;
+        char value[128];
+        bool found;
+    };
+
+    void consume(char c)
+    {
+        static const char openTag[] = "<title>";
+
+        switch (state)
+        {
+            case State::Search:
+                if (c == openTag[matched])
+                {
+                    if (openTag[++matched] == '\0')
+                    {
+                        state = State::Key;
+                        key_length = 0;
+                        matched = 0;
+                    }
+                }
+                else
+                    matched = (c == '<') ? 1 : 0;
+                break;
+
+            case State::Key:
+                if (c == ':')
+                {
+                    key_buffer[key_length] = '\0';
+                    current = lookup(key_buffer);
+                    state = current ? State::Value : State::Search;
+                    value_length = 0;
+                }
+                else if (c == '<' || key_length == sizeof(key_buffer) - 1)
+                {
+                    //not a title we care about
+                    state = State::Search;
+                    matched = (c == '<') ? 1 : 0;
+                }
+                else
+                    key_buffer[key_length++] = c;
+                break;
+
+            case State::Value:
+                if (c == '<')
+                {
+                    state = State::Tag;
+                    tag_length = 0;
+                }
+                else
+                    append(c);
+                break;
+
+            case State::Tag:
+                if (c == '>')
+                {
+                    tag[tag_length] = '\0';
+                    state = State::Value;
+                    if (strcmp(tag, "/title") == 0)
+                    {
+                        finish();
+                        state = State::Search;
+                    }
+                    else if (strcmp(tag, "br") == 0 || strcmp(tag, "br/") == 0)
+                        append("--");
+                    else
+                    {
+                        append('<');
+                        append(tag);
+                        append('>');
+                    }
+                }
+                else if (tag_length < sizeof(tag) - 1)
+                    tag[tag_length++] = c;
+                else
+                {
+                    //longer than any tag we replace, copied as it is
+                    tag[tag_length] = '\0';
+                    state = State::Value;
+                    append('<');
+                    append(tag);
+                    append(c);
+                }
+                break;
+        }
+    }
+
+    Slot* lookup(const char* key)
+    {
+        for (auto& slot : slots)
+            if (strcmp(slot.key, key) == 0)
+                return &slot;
+        return nullptr;
+    }
+
+    void append(char c)
+    {
+        //leading whitespace is dropped, trailing whitespace in finish()
+        if ((value_length == 0 && isspace((unsigned char)c)) || value_length == sizeof(current->value) - 1)
+            return;
+        current->value[value_length++] = c;
+    }
+
+    void append(const char* str)
+    {
+        while (*str)
+            append(*str++);
+    }
+
+    void finish()
+    {
+        while (value_length > 0 && isspace((unsigned char)current->value[value_length - 1]))
+            value_length--;
+        current->value[value_length] = '\0';
+
+        if (not current->found)
+            found_count++;
+        current->found = true;
+    }
+
+    int64_t (*clock)();
+    Slot slots[FIELD_COUNT];
+    int found_count = 0;
+    uint32_t parse_time_us = 0;     // spent in onData, without the network
+
+    State state = State::Search;
+    size_t matched = 0;         // characters of <title> matched so far
+    char key_buffer[24];
+    size_t key_length = 0;
+    Slot* current = nullptr;    // field the value is written to
+    size_t value_length = 0;
+    char tag[8];                // tag inside a value, e.g. br or /title, longer ones are not buffered
+    size_t tag_length = 0;
+};
+
+#endif // LHC_FIELD_EXTRACTOR_HPP
@@ -0,0 +1,85 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// Collects what is needed to size task stacks and spot leaks: the stack high water mark of the
+// registered tasks, free heap / largest block over time, and duration series (HTTP, fetch, parse).
+// Everything lives in fixed arrays, sampling and recording never allocate.
+class Metrics
+{
+public:
+    static const size_t MAX_TASKS = 10;
+    static const size_t MAX_SERIES = 12;
+    static const size_t HEAP_SAMPLES = 60;          // 10 minutes at the default period
+    static const size_t SERIES_SAMPLES = 16;        // most recent values kept per series
+    static const uint32_t SAMPLE_PERIOD_MS = 10000;
+
+    static Metrics& getInstance()
+    {
+        static Metrics instance;
+        return instance;
+    }
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // long running tasks only, stackSize as passed to xTaskCreate
+    void addTask(TaskHandle_t task, uint32_t stackSize);
+
+    // adds a value to the named series, the name is copied on first use
+    void recordDuration(const char* series, uint32_t us);
+
+    // one sample of the heap and of the task stacks, meant to be called every SAMPLE_PERIOD_MS
+    void sample();
+
+    // writes CSV lines between "#metrics begin" and "#metrics end", the "#" lines name the columns
+    void dump(Print& out);
+
+private:
+    Metrics();
+
+    struct TaskInfo
+    {
+        TaskHandle_t handle;
+        uint32_t stackSize;
+        uint32_t minFreeStack;
+    };
+
+    struct HeapSample
+    {
+        uint32_t timeMs;
+        uint32_t freeHeap;
+        uint32_t minFreeHeap;
+        uint32_t largestBlock;
+    };
+
+    struct Series
+    {
+        char name[24];
+        uint32_t count;
+        uint32_t minUs;
+        uint32_t maxUs;
+        uint64_t totalUs;
+        uint32_t recent[SERIES_SAMPLES];
+    };
+
+    SemaphoreHandle_t mutex;
+
+    TaskInfo tasks[MAX_TASKS];
+    size_t taskCount = 0;
+
+    HeapSample heap[HEAP_SAMPLES];
+    size_t heapNext = 0;
+    size_t heapCount = 0;
+
+    Series series[MAX_SERIES];
+    size_t seriesCount = 0;
+};
+
+#endif // METRICS_HPP
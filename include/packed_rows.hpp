@@ -0,0 +1,61 @@
+#ifndef PACKED_ROWS_HPP
+#define PACKED_ROWS_HPP
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Helpers for packed 1bpp rows, MSB first: the layout of GFXcanvas1 and of the LMDS frame buffer.
+// Kept free of Arduino so they can be tested on the host.
+
+// Returns 8 pixels of a packed (MSB first) row starting at pixel x,
+// pixels outside of [0, width) read as 0
+inline uint8_t readPackedByte(const uint8_t *row, int32_t width, int32_t x)
+{
+  if (x >= width || x <= -8)
+    return 0;
+  if (x < 0)
+    return readPackedByte(row, width, 0) >> -x;
+
+  int32_t i = x >> 3;
+  uint16_t w = row[i] << 8;
+  if ((i + 1) * 8 < width)
+    w |= row[i + 1];
+
+  uint8_t v = (w << (x & 7)) >> 8;
+  if (width - x < 8)
+    v &= 0xFF << (8 - (width - x));
+  return v;
+}
+
+// Copies `count` pixels of every row from a packed source to a packed destination.
+// Source pixels past srcWidth are copied as 0, destination pixels are clipped to dstWidth.
+inline void blitPackedRows(const uint8_t *src, int32_t srcStride, int32_t srcWidth, int32_t srcX,
+                           uint8_t *dst, int32_t dstStride, int32_t dstWidth, int32_t dstX,
+                           int32_t count, int16_t rows)
+{
+  int32_t lo = std::max<int32_t>(dstX, 0);
+  int32_t hi = std::min<int32_t>(dstX + count, dstWidth);
+  if (lo >= hi)
+    return;
+
+  for (int16_t y = 0; y < rows; y++)
+  {
+    const uint8_t *srcRow = src + y * srcStride;
+    uint8_t *dstRow = dst + y * dstStride;
+
+    for (int32_t b = lo >> 3; b <= (hi - 1) >> 3; b++)
+    {
+      int32_t px = b * 8;
+      int32_t first = std::max(lo, px);
+      int32_t last = std::min(hi, px + 8);
+      uint8_t mask = (0xFF >> (first - px)) & (0xFF << (px + 8 - last));
+
+      uint8_t v = readPackedByte(srcRow, srcWidth, px - dstX + srcX);
+      dstRow[b] = (dstRow[b] & ~mask) | (v & mask);
+    }
+  }
+}
+
+#endif // PACKED_ROWS_HPP
@@ -1,22 +1,85 @@
 #ifndef RESOURCE_MANAGER_HPP
 #define RESOURCE_MANAGER_HPP
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <metrics.hpp>
+
 // This class owns the handle to a resource and will wake up tasks that are
-// waiting for the resource to be free. It runs a dedicated task to manage access to the resource.
+// waiting for the resource to be free.
 // Only one task can access the resource at a time.
-// Requests are held in a queue and processed in FIFO order.
+// Requests carry a priority and an optional maximum wait: the highest priority request is granted first,
+// equal priorities are served earliest deadline first and then in FIFO order.
+// A request that is not granted before its deadline is dropped and make_access_request returns false.
+// While a higher priority request waits, yield_requested() returns true so the holder can stop early.
+//
+// Two interchangeable backends, selected at compile time:
+// - default: a dedicated manager task takes requests from a queue and hands the resource out
+// - RESOURCE_MANAGER_DIRECT_HANDOFF=1: no extra task, the waiter list is guarded by a spinlock
+//   and release_access() notifies the next owner directly
+// Hand-off latency (release until the next owner runs) is measured by both, see get_handoff_stats().
+// test_handoff_task and test_handoff_direct run the same contention benchmark on each backend.
+
+#ifndef RESOURCE_MANAGER_DIRECT_HANDOFF
+#define RESOURCE_MANAGER_DIRECT_HANDOFF 0
+#endif
 
 template<class R>
 class ResourceManager
 {
 public:
+    static const uint8_t PRIORITY_LOW = 0;      // bulk content, e.g. long marquees
+    static const uint8_t PRIORITY_NORMAL = 1;
+    static const uint8_t PRIORITY_HIGH = 2;     // time critical content, e.g. the clock
+
+    static const uint8_t MAX_REQUESTERS = 8;
+    static const uint8_t HISTOGRAM_BUCKETS = 16;
+
+    // Wait and hold times of a single task, bucket i counts durations in [2^(i-1), 2^i) ms,
+    // bucket 0 is below 1 ms and the last bucket collects everything longer.
+    struct RequesterStats
+    {
+        TaskHandle_t task;
+        uint32_t grants;
+        uint32_t denials;
+        uint32_t max_wait_ms;
+        uint32_t max_hold_ms;
+        uint32_t wait_histogram[HISTOGRAM_BUCKETS];
+        uint32_t hold_histogram[HISTOGRAM_BUCKETS];
+    };
+
+    // Contended hand-offs only, the histogram uses the same buckets in microseconds
+    struct HandoffStats
+    {
+        uint32_t count;
+        uint32_t max_us;
+        uint64_t total_us;
+        uint32_t histogram[HISTOGRAM_BUCKETS];
+    };
+
     ResourceManager()
     {
         resource = nullptr;
         current_task = nullptr;
+        current_priority = 0;
+        granted_tick = 0;
         request_queue = nullptr;
         manager_task = nullptr;
-    }   
+        pending = nullptr;
+        pending_count = 0;
+        pending_capacity = 0;
+        next_sequence = 0;
+        yield_flag = false;
+        released_us = 0;
+        handoff_from_us = 0;
+        grant_handoff_us = 0;
+        handoff = HandoffStats();
+        requester_count = 0;
+        portMUX_INITIALIZE(&lock);
+        portMUX_INITIALIZE(&stats_lock);
+    }
 
     static ResourceManager& getInstance()
     {
@@ -30,53 +93,195 @@ public:
         {
             vQueueDelete(request_queue);
         }
+        delete[] pending;
+    }
+
+#if RESOURCE_MANAGER_DIRECT_HANDOFF
+
+    void initialize(R* resource, uint16_t queue_length = 8)
+    {
+        this->resource = resource;
+        pending = new Request[queue_length];
+        pending_capacity = queue_length;
+    }
+
+    // Blocks until access is granted (true) or the waiter list is full or
+    // access was not granted within max_wait ticks (false).
+    bool make_access_request(uint8_t priority = PRIORITY_NORMAL, TickType_t max_wait = portMAX_DELAY)
+    {
+        Request request = make_request(priority, max_wait);
+
+        taskENTER_CRITICAL(&lock);
+        if (current_task == nullptr && pending_count == 0)
+        {
+            // uncontended, take it right away
+            grant(request);
+            taskEXIT_CRITICAL(&lock);
+            record_wait(request, granted_tick);
+            return true;
+        }
+        if (pending_count == pending_capacity)
+        {
+            taskEXIT_CRITICAL(&lock);
+            return false;
+        }
+        request.sequence = next_sequence++;
+        pending[pending_count++] = request;
+        if (priority > current_priority)
+            yield_flag = true;
+        taskEXIT_CRITICAL(&lock);
+
+        uint32_t result = 0;
+        if (xTaskNotifyWait(0, UINT32_MAX, &result, max_wait) == pdTRUE && result == GRANTED)
+        {
+            on_granted(request);
+            return true;
+        }
+
+        // timed out, unless release_access() picked us in the meantime
+        taskENTER_CRITICAL(&lock);
+        bool still_waiting = false;
+        for (int i = 0; i < pending_count; i++)
+        {
+            if (pending[i].task == request.task)
+            {
+                remove_request(i);
+                update_yield_flag();
+                still_waiting = true;
+                break;
+            }
+        }
+        taskEXIT_CRITICAL(&lock);
+
+        if (still_waiting)
+        {
+            record_denial(request.task);
+            return false;
+        }
+
+        // the grant is already on its way
+        xTaskNotifyWait(0, UINT32_MAX, &result, portMAX_DELAY);
+        on_granted(request);
+        return true;
+    }
+
+    void release_access()
+    {
+        TaskHandle_t releaser = xTaskGetCurrentTaskHandle();
+        TickType_t held_since = granted_tick;
+
+        taskENTER_CRITICAL(&lock);
+        // Only the task that currently has access can release it
+        if (releaser != current_task)
+        {
+            taskEXIT_CRITICAL(&lock);
+            return;
+        }
+
+        TaskHandle_t next = nullptr;
+        int best = select_request();
+        if (best >= 0)
+        {
+            Request request = pending[best];
+            remove_request(best);
+            handoff_from_us = esp_timer_get_time();
+            grant(request);
+            next = request.task;
+        }
+        else
+        {
+            current_task = nullptr;
+            current_priority = 0;
+            yield_flag = false;
+        }
+        taskEXIT_CRITICAL(&lock);
+
+        record_hold(releaser, held_since);
+        if (next)
+            xTaskNotify(next, GRANTED, eSetValueWithOverwrite);
     }
 
-    void initialize(R* resource, uint16_t queue_length = 3)
+#else
+
+    void initialize(R* resource, uint16_t queue_length = 8)
     {
         this->resource = resource;
-        request_queue = xQueueCreate(queue_length, sizeof(TaskHandle_t));
+        pending = new Request[queue_length];
+        pending_capacity = queue_length;
+        request_queue = xQueueCreate(queue_length, sizeof(Request));
         xTaskCreate(manager_task_function, "ResourceManager", 2048, this, 1, &manager_task);
+        Metrics::getInstance().addTask(manager_task, 2048);
     }
 
     static void manager_task_function(void *parameter)
     {
         ResourceManager *manager = static_cast<ResourceManager *>(parameter);
 
-        //this will be populated by the task that wants to access the resource
-        TaskHandle_t requesting_task = nullptr;
-
         //Serial.println("ResourceManager: Task started");
         while (true)
         {
-            // Wait for a task to request access
-            if (xQueueReceive(manager->request_queue, &requesting_task, 1000 / portTICK_PERIOD_MS) == pdTRUE)
+            // Wait for a task to request access, don't block if there are requests pending already
+            manager->collect_requests(manager->pending_count ? 0 : portMAX_DELAY);
+            manager->expire_requests();
+
+            int best = manager->select_request();
+            if (best < 0)
+            {
+                manager->handoff_from_us = 0;
+                continue;
+            }
+
+            Request request = manager->pending[best];
+            manager->remove_request(best);
+
+            //Serial.printf("ResourceManager: Task %s granted access\n", pcTaskGetName(request.task));
+            // Grant access to the requesting task
+            manager->grant(request);
+            manager->record_wait(request, manager->granted_tick);
+            xTaskNotify(request.task, GRANTED, eSetValueWithOverwrite);
+
+            // Wait for the task to release the resource. Meanwhile wake up for new requests
+            // and for the earliest deadline of the waiting ones, nothing else
+            while (true)
             {
-                //Serial.printf("ResourceManager: Task %s granted access\n", pcTaskGetName(requesting_task));
-                // Grant access to the requesting task
-                manager->current_task = requesting_task;
-                xTaskNotifyGive(requesting_task);
-
-                // Wait for the task to release the display
-                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-                manager->current_task = nullptr;
-                //Serial.printf("ResourceManager: Task %s released access\n", pcTaskGetName(requesting_task));
+                uint32_t events = 0;
+                xTaskNotifyWait(0, UINT32_MAX, &events, manager->ticks_to_next_deadline());
+                if (events & NOTIFY_RELEASED)
+                    break;
+                manager->collect_requests(0);
+                manager->expire_requests();
+                manager->update_yield_flag();
             }
 
-            //Serial.printf("ResourceManager: %d tasks waiting\n", uxQueueMessagesWaiting(manager->request_queue));
+            manager->record_hold(request.task, manager->granted_tick);
+            manager->yield_flag = false;
+            manager->current_task = nullptr;
+
+            // a request that was already waiting makes this a contended hand-off
+            manager->collect_requests(0);
+            manager->handoff_from_us = manager->pending_count ? manager->released_us : 0;
+            //Serial.printf("ResourceManager: Task %s released access\n", pcTaskGetName(request.task));
         }
     }
 
-    bool make_access_request()
+    // Blocks until access is granted (true) or the request could not be queued or
+    // was not granted within max_wait ticks (false).
+    bool make_access_request(uint8_t priority = PRIORITY_NORMAL, TickType_t max_wait = portMAX_DELAY)
     {
-        TaskHandle_t requester = xTaskGetCurrentTaskHandle();
-        //Serial.printf("ResourceManager: Task %s making access request\n", pcTaskGetName(requester));
-        if (xQueueSend(request_queue, &requester, 0) != pdTRUE)
+        Request request = make_request(priority, max_wait);
+
+        //Serial.printf("ResourceManager: Task %s making access request\n", pcTaskGetName(request.task));
+        if (xQueueSend(request_queue, &request, 0) != pdTRUE)
+            return false;
+        xTaskNotify(manager_task, NOTIFY_REQUEST, eSetBits);
+
+        // wait for the manager to grant or drop the request
+        uint32_t result = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &result, portMAX_DELAY);
+        if (result != GRANTED)
             return false;
-        
-        // wait for the display manager to grant access
-        // the task will be suspended and resumed by the display manager
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        on_granted(request);
         return true;
     }
 
@@ -86,9 +291,68 @@ public:
         if (xTaskGetCurrentTaskHandle() == current_task)
         {
             //Serial.printf("ResourceManager: Task %s releasing access\n", pcTaskGetName(current_task));
-            // Notify the display manager that the task is done
-            xTaskNotifyGive(manager_task);
+            // Notify the manager that the task is done
+            released_us = esp_timer_get_time();
+            xTaskNotify(manager_task, NOTIFY_RELEASED, eSetBits);
+        }
+    }
+
+#endif
+
+    // True while a request with higher priority than the current holder's is waiting
+    bool yield_requested() const
+    {
+        return yield_flag;
+    }
+
+    size_t get_requester_count()
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        size_t count = requester_count;
+        taskEXIT_CRITICAL(&stats_lock);
+        return count;
+    }
+
+    bool get_requester_stats(size_t index, RequesterStats& out)
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        bool valid = index < requester_count;
+        if (valid)
+            out = requesters[index];
+        taskEXIT_CRITICAL(&stats_lock);
+        return valid;
+    }
+
+    HandoffStats get_handoff_stats()
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        HandoffStats stats = handoff;
+        taskEXIT_CRITICAL(&stats_lock);
+        return stats;
+    }
+
+    // one line per requester: name, grants, denials, max wait/hold and both histograms,
+    // followed by the hand-off latency line
+    template <class S>
+    void statsToSerial(S& serial)
+    {
+        RequesterStats stats;
+        for (size_t i = 0; get_requester_stats(i, stats); i++)
+        {
+            serial.printf("%s grants=%u denials=%u max_wait_ms=%u max_hold_ms=%u wait=",
+                pcTaskGetName(stats.task), stats.grants, stats.denials, stats.max_wait_ms, stats.max_hold_ms);
+            print_histogram(serial, stats.wait_histogram);
+            serial.print(" hold=");
+            print_histogram(serial, stats.hold_histogram);
+            serial.println();
         }
+
+        HandoffStats h = get_handoff_stats();
+        serial.printf("handoff backend=%s count=%u avg_us=%u max_us=%u us=",
+            RESOURCE_MANAGER_DIRECT_HANDOFF ? "direct" : "task",
+            h.count, h.count ? uint32_t(h.total_us / h.count) : 0, h.max_us);
+        print_histogram(serial, h.histogram);
+        serial.println();
     }
 
     R* getResource()
@@ -102,12 +366,250 @@ public:
     }
 
 private:
+    static const uint32_t GRANTED = 1;
+    static const uint32_t DENIED = 2;
+
+    // notification bits of the manager task
+    static const uint32_t NOTIFY_RELEASED = 1;
+    static const uint32_t NOTIFY_REQUEST = 2;
+
+    struct Request
+    {
+        TaskHandle_t task;
+        uint8_t priority;
+        bool has_deadline;
+        TickType_t enqueued;
+        TickType_t deadline;
+        uint32_t sequence;
+    };
+
+    static Request make_request(uint8_t priority, TickType_t max_wait)
+    {
+        Request request;
+        request.task = xTaskGetCurrentTaskHandle();
+        request.priority = priority;
+        request.enqueued = xTaskGetTickCount();
+        request.has_deadline = max_wait != portMAX_DELAY;
+        request.deadline = request.enqueued + max_wait;
+        request.sequence = 0;
+        return request;
+    }
+
+    // makes the request the current owner and remembers where its hand-off started
+    void grant(const Request& request)
+    {
+        granted_tick = xTaskGetTickCount();
+        current_priority = request.priority;
+        current_task = request.task;
+        grant_handoff_us = handoff_from_us;
+        handoff_from_us = 0;
+        update_yield_flag();
+    }
+
+    // runs on the new owner once it is awake
+    void on_granted(const Request& request)
+    {
+#if RESOURCE_MANAGER_DIRECT_HANDOFF
+        record_wait(request, granted_tick);
+#else
+        (void)request;  // the manager task has recorded the wait already
+#endif
+        if (grant_handoff_us)
+            record_handoff(esp_timer_get_time() - grant_handoff_us);
+    }
+
+#if !RESOURCE_MANAGER_DIRECT_HANDOFF
+    void collect_requests(TickType_t wait)
+    {
+        Request request;
+        while (pending_count < pending_capacity && xQueueReceive(request_queue, &request, wait) == pdTRUE)
+        {
+            request.sequence = next_sequence++;
+            pending[pending_count++] = request;
+            wait = 0;
+        }
+    }
+
+    // how long the manager may sleep before a waiting request runs out of time
+    TickType_t ticks_to_next_deadline() const
+    {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        for (int i = 0; i < pending_count; i++)
+        {
+            const Request& request = pending[i];
+            if (not request.has_deadline)
+                continue;
+            TickType_t total = request.deadline - request.enqueued;
+            TickType_t elapsed = now - request.enqueued;
+            TickType_t left = elapsed >= total ? 0 : total - elapsed;
+            if (left < wait)
+                wait = left;
+        }
+        return wait;
+    }
+
+    void expire_requests()
+    {
+        TickType_t now = xTaskGetTickCount();
+        for (int i = pending_count - 1; i >= 0; i--)
+        {
+            const Request& request = pending[i];
+            if (request.has_deadline && TickType_t(now - request.enqueued) >= TickType_t(request.deadline - request.enqueued))
+            {
+                record_denial(request.task);
+                xTaskNotify(request.task, DENIED, eSetValueWithOverwrite);
+                remove_request(i);
+            }
+        }
+    }
+#endif
+
+    void update_yield_flag()
+    {
+        int next = select_request();
+        yield_flag = next >= 0 && pending[next].priority > current_priority;
+    }
+
+    // index of the request to be served next or -1
+    int select_request() const
+    {
+        int best = -1;
+        for (int i = 0; i < pending_count; i++)
+        {
+            if (best < 0 || goes_before(pending[i], pending[best]))
+                best = i;
+        }
+        return best;
+    }
+
+    static bool goes_before(const Request& a, const Request& b)
+    {
+        if (a.priority != b.priority)
+            return a.priority > b.priority;
+        if (a.has_deadline != b.has_deadline)
+            return a.has_deadline;
+        if (a.has_deadline && a.deadline != b.deadline)
+            return TickType_t(a.deadline - b.deadline) > (portMAX_DELAY >> 1);    // a is earlier, wrap-around safe
+        return a.sequence < b.sequence;
+    }
+
+    void remove_request(int index)
+    {
+        for (int i = index; i < pending_count - 1; i++)
+            pending[i] = pending[i + 1];
+        pending_count--;
+    }
+
+    static uint8_t histogram_bucket(uint32_t value)
+    {
+        uint8_t bucket = 0;
+        while (value && bucket < HISTOGRAM_BUCKETS - 1)
+        {
+            value >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    template <class S>
+    static void print_histogram(S& serial, const uint32_t* histogram)
+    {
+        for (uint8_t b = 0; b < HISTOGRAM_BUCKETS; b++)
+            serial.printf(b ? ",%u" : "%u", histogram[b]);
+    }
+
+    // called with stats_lock held
+    RequesterStats* find_requester(TaskHandle_t task)
+    {
+        for (size_t i = 0; i < requester_count; i++)
+        {
+            if (requesters[i].task == task)
+                return &requesters[i];
+        }
+        if (requester_count == MAX_REQUESTERS)
+            return nullptr;
+
+        RequesterStats* stats = &requesters[requester_count++];
+        *stats = RequesterStats();
+        stats->task = task;
+        return stats;
+    }
+
+    void record_wait(const Request& request, TickType_t granted)
+    {
+        uint32_t ms = (granted - request.enqueued) * portTICK_PERIOD_MS;
+        taskENTER_CRITICAL(&stats_lock);
+        RequesterStats* stats = find_requester(request.task);
+        if (stats)
+        {
+            stats->grants++;
+            stats->wait_histogram[histogram_bucket(ms)]++;
+            if (ms > stats->max_wait_ms)
+                stats->max_wait_ms = ms;
+        }
+        taskEXIT_CRITICAL(&stats_lock);
+    }
+
+    void record_hold(TaskHandle_t task, TickType_t granted)
+    {
+        uint32_t ms = (xTaskGetTickCount() - granted) * portTICK_PERIOD_MS;
+        taskENTER_CRITICAL(&stats_lock);
+        RequesterStats* stats = find_requester(task);
+        if (stats)
+        {
+            stats->hold_histogram[histogram_bucket(ms)]++;
+            if (ms > stats->max_hold_ms)
+                stats->max_hold_ms = ms;
+        }
+        taskEXIT_CRITICAL(&stats_lock);
+    }
+
+    void record_denial(TaskHandle_t task)
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        RequesterStats* stats = find_requester(task);
+        if (stats)
+            stats->denials++;
+        taskEXIT_CRITICAL(&stats_lock);
+    }
+
+    void record_handoff(int64_t us)
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        handoff.count++;
+        handoff.total_us += us;
+        handoff.histogram[histogram_bucket(us)]++;
+        if (us > handoff.max_us)
+            handoff.max_us = us;
+        taskEXIT_CRITICAL(&stats_lock);
+    }
+
     R *resource;
-    TaskHandle_t current_task;
-    QueueHandle_t request_queue;
-    TaskHandle_t manager_task;
+    volatile TaskHandle_t current_task;
+    uint8_t current_priority;
+    TickType_t granted_tick;
+    QueueHandle_t request_queue;    // task backend only
+    TaskHandle_t manager_task;      // task backend only
+
+    // waiting requests, owned by the manager task or guarded by `lock` in the direct backend
+    portMUX_TYPE lock;
+    Request *pending;
+    int pending_count;
+    int pending_capacity;
+    uint32_t next_sequence;
+    volatile bool yield_flag;
+
+    // hand-off latency measurement
+    volatile int64_t released_us;
+    int64_t handoff_from_us;
+    int64_t grant_handoff_us;
+
+    portMUX_TYPE stats_lock;
+    RequesterStats requesters[MAX_REQUESTERS];
+    size_t requester_count;
+    HandoffStats handoff;
 };
 
 
 #endif // RESOURCE_MANAGER_HPP
-  
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef STRIP_CACHE_HPP
+#define STRIP_CACHE_HPP
+
+#include <Adafruit_GFX.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A message rendered once into column bytes, bit 0 is the top row.
+struct MessageStrip
+{
+    std::vector<uint8_t> columns;
+
+    int width() const { return columns.size(); }
+};
+
+// Small LRU cache of rendered message strips, keyed by text and font.
+// Scrolling the same message again only costs a lookup.
+// Strips are handed out as shared pointers so an eviction done by another task
+// never frees a strip that is still being scrolled.
+class StripCache
+{
+public:
+    static const size_t DEFAULT_BUDGET = 4096;
+
+    struct Stats
+    {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t evictions;
+        size_t bytes;
+        size_t entries;
+    };
+
+    static StripCache& getInstance()
+    {
+        static StripCache instance;
+        return instance;
+    }
+
+    StripCache(const StripCache&) = delete;
+    StripCache& operator=(const StripCache&) = delete;
+
+    // font == nullptr means the built-in 6x8 font
+    std::shared_ptr<const MessageStrip> get(const std::string& text, const GFXfont* font = nullptr);
+
+    // memory budget in bytes (strip columns + key text), the newest entry is always kept
+    void setBudget(size_t bytes);
+    Stats getStats();
+    void clear();
+
+private:
+    StripCache();
+
+    struct Entry
+    {
+        std::string text;
+        const GFXfont* font;
+        std::shared_ptr<const MessageStrip> strip;
+
+        size_t bytes() const { return text.size() + strip->columns.size(); }
+    };
+
+    void evict();
+
+    SemaphoreHandle_t mutex;
+    std::list<Entry> entries;   // most recently used first
+    size_t budget = DEFAULT_BUDGET;
+    Stats stats = {};
+};
+
+#endif // STRIP_CACHE_HPP
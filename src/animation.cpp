@@ -0,0 +1,87 @@
+#include <animation.hpp>
+#include <resource_manager.hpp>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <climits>
+
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+static AnimationStats totalStats = {0, 0, INT32_MAX, INT32_MIN, 0};
+
+static void mergeStats(AnimationStats& into, const AnimationStats& from)
+{
+    into.frames += from.frames;
+    into.dropped += from.dropped;
+    into.minLatenessUs = std::min(into.minLatenessUs, from.minLatenessUs);
+    into.maxLatenessUs = std::max(into.maxLatenessUs, from.maxLatenessUs);
+    into.totalLatenessUs += from.totalLatenessUs;
+}
+
+AnimationStats runAnimation(Animation& animation, LMDS& display, uint32_t framePeriodMs,
+                            const std::function<bool()>& stop)
+{
+    AnimationStats stats = {0, 0, INT32_MAX, INT32_MIN, 0};
+    uint32_t count = animation.frameCount();
+    if (count == 0)
+        return stats;
+
+    const TickType_t period = std::max<TickType_t>(pdMS_TO_TICKS(framePeriodMs), 1);
+    const int64_t periodUs = int64_t(period) * portTICK_PERIOD_MS * 1000;
+
+    const TickType_t startTick = xTaskGetTickCount();
+    const int64_t startUs = esp_timer_get_time();
+
+    uint32_t frame = 0;
+    while (true)
+    {
+        int64_t now = esp_timer_get_time();
+
+        //skip the frames whose slot has already passed, but never the last one
+        uint32_t due = std::min<int64_t>((now - startUs) / periodUs, count - 1);
+        if (due > frame)
+        {
+            stats.dropped += due - frame;
+            frame = due;
+        }
+
+        int32_t lateness = now - (startUs + frame * periodUs);
+        stats.minLatenessUs = std::min(stats.minLatenessUs, lateness);
+        stats.maxLatenessUs = std::max(stats.maxLatenessUs, lateness);
+        stats.totalLatenessUs += lateness;
+
+        animation.renderFrame(display, frame);
+        display.present();
+        stats.frames++;
+
+        if (++frame >= count)
+            break;
+
+        //something more important is waiting, give the display up early
+        if (ResourceManager<LMDS>::getInstance().yield_requested() || (stop && stop()))
+        {
+            stats.dropped += count - frame;
+            break;
+        }
+
+        //sleep until the deadline of the next frame
+        TickType_t lastWake = startTick + (frame - 1) * period;
+        vTaskDelayUntil(&lastWake, period);
+    }
+
+    taskENTER_CRITICAL(&statsLock);
+    mergeStats(totalStats, stats);
+    taskEXIT_CRITICAL(&statsLock);
+
+    Serial.printf("Animation: %u frames, %u dropped, lateness avg %d us, jitter %d us\n",
+        stats.frames, stats.dropped, stats.averageLatenessUs(), stats.jitterUs());
+    return stats;
+}
+
+AnimationStats getAnimationStats()
+{
+    taskENTER_CRITICAL(&statsLock);
+    AnimationStats s = totalStats;
+    taskEXIT_CRITICAL(&statsLock);
+    return s;
+}
@@ -0,0 +1,130 @@
+#include <boot_progress.hpp>
+#include <wifi_mananger.h>
+#include <compositor.hpp>
+#include <resource_manager.hpp>
+#include <LMDS.hpp>
+#include <metrics.hpp>
+
+#include <WiFi.h>
+#include <time.h>
+#include <algorithm>
+
+//anything earlier means NTP has not set the clock yet
+static const time_t CLOCK_SET_AFTER = 1600000000;
+
+static const char* const milestoneNames[BootProgress::MILESTONE_COUNT] = {
+    "first frame", "wifi", "time", "first content"
+};
+static const char* const milestoneSeries[BootProgress::MILESTONE_COUNT] = {
+    "boot.frame", "boot.wifi", "boot.time", "boot.content"
+};
+
+void BootProgress::begin(std::function<void()> onOnline)
+{
+    if (state != State::Idle)
+        return;
+    this->onOnline = onOnline;
+
+    //SNTP keeps trying in the background and syncs as soon as the network is up
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+
+    WiFiManager& wifiManager = getWiFiManagerInstance();
+    static WiFiManagerParameter display_segments("display_segments", "Display Segments", "8", 2);
+    wifiManager.addParameter(&display_segments);
+    wifiManager.setConfigPortalBlocking(false);
+
+    WiFi.mode(WIFI_STA);
+    if (wifiManager.getWiFiIsSaved())
+    {
+        Serial.println("Boot: Connecting to WiFi...");
+        WiFi.begin();
+        connectStart = millis();
+        state = State::Connecting;
+        showStatus("WiFi...");
+    }
+    else
+        startPortal();
+}
+
+void BootProgress::startPortal()
+{
+    WiFiManager& wifiManager = getWiFiManagerInstance();
+    wifiManager.startConfigPortal();
+    state = State::Portal;
+
+    Serial.printf("Boot: Configuration portal on %s\n", wifiManager.getConfigPortalSSID().c_str());
+    showStatus(std::string("WiFi setup: ") + wifiManager.getConfigPortalSSID().c_str());
+}
+
+uint32_t BootProgress::poll()
+{
+    if (not timeSet() && time(nullptr) > CLOCK_SET_AFTER)
+        reached(TIME);
+
+    switch (state)
+    {
+        case State::Idle:
+        case State::Done:
+            return UINT32_MAX;
+
+        case State::Connecting:
+            if (WiFi.status() != WL_CONNECTED)
+            {
+                if (millis() - connectStart >= WIFI_CONNECT_TIMEOUT_MS)
+                {
+                    Serial.println("Boot: Saved WiFi not reachable");
+                    startPortal();
+                }
+                return POLL_PERIOD_MS;
+            }
+            break;
+
+        case State::Portal:
+            //serves the portal, true once the new credentials connected
+            if (not getWiFiManagerInstance().process())
+                return POLL_PERIOD_MS;
+            break;
+
+        case State::Online:
+            if (not timeSet())
+                return POLL_PERIOD_MS * 10;
+            Compositor::getInstance().remove("boot");
+            state = State::Done;
+            return UINT32_MAX;
+    }
+
+    //just connected
+    Serial.printf("Boot: WiFi connected, IP %s\n", WiFi.localIP().toString().c_str());
+    reached(WIFI);
+    state = State::Online;
+    showStatus("Time...");
+    if (onOnline)
+        onOnline();
+    return 0;
+}
+
+void BootProgress::reached(Milestone milestone)
+{
+    uint32_t expected = 0;
+    uint32_t now = std::max<uint32_t>(millis(), 1);
+    if (not times[milestone].compare_exchange_strong(expected, now))
+        return;
+
+    Serial.printf("Boot: %s after %u ms\n", milestoneNames[milestone], now);
+    Metrics::getInstance().recordDuration(milestoneSeries[milestone], std::min<uint32_t>(now, UINT32_MAX / 1000) * 1000);
+}
+
+// what boot is waiting for, alternating with the clock until the time is set
+void BootProgress::showStatus(const std::string& text)
+{
+    if (text == status)
+        return;
+    status = text;
+
+    ContentItem item;
+    item.id = "boot";
+    item.text = text;
+    item.intervalMs = 1000;
+    item.priority = ResourceManager<LMDS>::PRIORITY_HIGH;
+    Compositor::getInstance().publish(item);
+}
@@ -0,0 +1,199 @@
+#include <compositor.hpp>
+#include <animation.hpp>
+#include <graphic_utils.hpp>
+#include <resource_manager.hpp>
+#include <metrics.hpp>
+#include <boot_progress.hpp>
+
+#include <algorithm>
+
+// Frames of a render callback, the callback gets the time since the item started
+class RenderAnimation : public Animation
+{
+public:
+    RenderAnimation(const ContentItem& item)
+        : item(item), frames(std::max<uint32_t>(item.durationMs / std::max<uint32_t>(item.framePeriodMs, 1), 1)) {}
+
+    uint32_t frameCount() const override { return frames; }
+
+    void renderFrame(LMDS& display, uint32_t frame) override
+    {
+        item.render(display, frame * item.framePeriodMs);
+    }
+
+private:
+    const ContentItem& item;
+    uint32_t frames;
+};
+
+Compositor::Compositor()
+{
+    mutex = xSemaphoreCreateMutex();
+}
+
+void Compositor::begin()
+{
+    if (task == nullptr)
+    {
+        xTaskCreate(compositor_task_function, "Compositor", 4096, this, 1, &task);
+        Metrics::getInstance().addTask(task, 4096);
+    }
+}
+
+void Compositor::publish(const ContentItem& item)
+{
+    auto shared = std::make_shared<const ContentItem>(item);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto it = std::find_if(entries.begin(), entries.end(),
+        [&item](const Entry& e) { return e.item->id == item.id; });
+    if (it != entries.end())
+        it->item = shared;
+    else
+        entries.push_back(Entry{shared, xTaskGetTickCount(), false});
+    xSemaphoreGive(mutex);
+}
+
+void Compositor::remove(const std::string& id)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [&id](const Entry& e) { return e.item->id == id; }), entries.end());
+    xSemaphoreGive(mutex);
+}
+
+bool Compositor::isDue(const Entry& entry, TickType_t now) const
+{
+    return not entry.shown || (now - entry.lastShown) * portTICK_PERIOD_MS >= entry.item->intervalMs;
+}
+
+std::shared_ptr<const ContentItem> Compositor::pickNext()
+{
+    TickType_t now = xTaskGetTickCount();
+    std::shared_ptr<const ContentItem> next;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    const Entry* best = nullptr;
+    for (const auto& entry : entries)
+    {
+        if (not isDue(entry, now))
+            continue;
+
+        //higher priority first, then the one that waited longest
+        if (best == nullptr || entry.item->priority > best->item->priority ||
+            (entry.item->priority == best->item->priority &&
+             (best->shown && (not entry.shown || int32_t(entry.lastShown - best->lastShown) < 0))))
+            best = &entry;
+    }
+    if (best)
+        next = best->item;
+    xSemaphoreGive(mutex);
+
+    return next;
+}
+
+bool Compositor::overdueAbove(uint8_t priority)
+{
+    TickType_t now = xTaskGetTickCount();
+    bool overdue = false;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const auto& entry : entries)
+    {
+        const ContentItem& item = *entry.item;
+        if (item.priority <= priority || item.maxLatenessMs == UINT32_MAX || not isDue(entry, now))
+            continue;
+
+        //never shown items count as due since they were published
+        TickType_t dueSince = entry.shown ? entry.lastShown + item.intervalMs / portTICK_PERIOD_MS : entry.lastShown;
+        if ((now - dueSince) * portTICK_PERIOD_MS > item.maxLatenessMs)
+        {
+            overdue = true;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    return overdue;
+}
+
+void Compositor::markShown(const std::string& id)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto& entry : entries)
+    {
+        if (entry.item->id == id)
+        {
+            entry.lastShown = xTaskGetTickCount();
+            entry.shown = true;
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void Compositor::show(const ContentItem& item, LMDS& display)
+{
+    auto stop = [this, &item]() { return overdueAbove(item.priority); };
+
+    switch (item.kind)
+    {
+        case ContentItem::Kind::Text:
+            showStrip(*StripCache::getInstance().get(item.text), display, item.framePeriodMs, 6, stop);
+            break;
+
+        case ContentItem::Kind::Strip:
+            if (item.strip)
+                showStrip(*item.strip, display, item.framePeriodMs, 6, stop);
+            break;
+
+        case ContentItem::Kind::Render:
+        {
+            RenderAnimation animation(item);
+            runAnimation(animation, display, item.framePeriodMs, stop);
+            break;
+        }
+    }
+
+    switch (item.transition)
+    {
+        case ContentItem::Transition::Wipe:
+            wipeDisplayLeftToRight(display);
+            break;
+        case ContentItem::Transition::ScrollOut:
+            scrollOutDisplayRight(display);
+            break;
+        case ContentItem::Transition::None:
+            break;
+    }
+}
+
+void Compositor::compositor_task_function(void* parameter)
+{
+    Compositor* compositor = static_cast<Compositor*>(parameter);
+    auto& rmd = ResourceManager<LMDS>::getInstance();
+    auto& display = rmd.getResourceRef();
+
+    while (true)
+    {
+        auto item = compositor->pickNext();
+        if (not item)
+        {
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        if (not rmd.make_access_request(item->priority, 1000 / portTICK_PERIOD_MS))
+        {
+            Serial.println("Compositor: Failed to get access to display");
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        Serial.printf("Compositor: showing %s\n", item->id.c_str());
+        BootProgress::getInstance().reached(BootProgress::FIRST_FRAME);
+        compositor->show(*item, display);
+        rmd.release_access();
+
+        compositor->markShown(item->id);
+    }
+}
@@ -0,0 +1,173 @@
+#include <content_cache.hpp>
+#include <boot_progress.hpp>
+#include <LittleFS.h>
+#include <Arduino.h>
+
+#include <stdlib.h>
+#include <vector>
+
+static const char contentFile[] = "/content_cache.txt";
+static const char temporaryFile[] = "/content_cache.txt.tmp";
+
+//anything earlier means NTP has not set the clock yet
+static const time_t CLOCK_SET_AFTER = 1600000000;
+
+// a line holds tab separated fields, so tabs, line breaks and backslashes in the id and text are escaped
+static std::string escape(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string unescape(const char* begin, const char* end)
+{
+    std::string text;
+    text.reserve(end - begin);
+    for (const char* c = begin; c < end; c++)
+    {
+        if (*c != '\\' || c + 1 == end)
+        {
+            text += *c;
+            continue;
+        }
+        switch (*++c)
+        {
+            case 't': text += '\t'; break;
+            case 'n': text += '\n'; break;
+            case 'r': text += '\r'; break;
+            default: text += *c;
+        }
+    }
+    return text;
+}
+
+ContentCache::ContentCache()
+{
+    mutex = xSemaphoreCreateMutex();
+}
+
+void ContentCache::publish(const ContentItem& item)
+{
+    Compositor::getInstance().publish(item);
+    BootProgress::getInstance().reached(BootProgress::FIRST_CONTENT);
+    if (item.kind != ContentItem::Kind::Text)
+        return;
+
+    time_t now = time(nullptr);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Entry& entry = entries[item.id];
+    //an unchanged text only refreshes the time, it is written with the next change
+    if (entry.text != item.text || entry.intervalMs != item.intervalMs || entry.priority != item.priority)
+        dirty = true;
+    entry.text = item.text;
+    entry.timestamp = now > CLOCK_SET_AFTER ? now : 0;
+    entry.intervalMs = item.intervalMs;
+    entry.priority = item.priority;
+
+    //a change that is not written yet goes out with a later publish
+    bool due = dirty && (not saved || millis() - lastSave >= SAVE_INTERVAL_MS);
+    std::vector<std::pair<std::string, Entry>> snapshot;
+    if (due)
+    {
+        snapshot.assign(entries.begin(), entries.end());
+        //taken now, so no other publish starts a write while this one is running
+        dirty = false;
+        saved = true;
+        lastSave = millis();
+    }
+    xSemaphoreGive(mutex);
+
+    if (due && not save(snapshot))
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        dirty = true;
+        xSemaphoreGive(mutex);
+    }
+}
+
+// without the mutex, the flash write would block every other publisher. Written to a temporary
+// file and renamed over the cache, a reset or a full flash mid-write keeps the last complete one
+bool ContentCache::save(const std::vector<std::pair<std::string, Entry>>& snapshot)
+{
+    LittleFS.begin(true);
+    File file = LittleFS.open(temporaryFile, "w");
+    if (!file) {
+        Serial.println("ContentCache: Failed to write content cache");
+        return false;
+    }
+    bool ok = true;
+    char numbers[48];
+    for (const auto& entry : snapshot)
+    {
+        snprintf(numbers, sizeof(numbers), "\t%ld\t%u\t%u\t", (long)entry.second.timestamp,
+            (unsigned)entry.second.intervalMs, (unsigned)entry.second.priority);
+        std::string line = escape(entry.first) + numbers + escape(entry.second.text) + "\n";
+        ok = ok && file.write(reinterpret_cast<const uint8_t*>(line.data()), line.size()) == line.size();
+    }
+    file.close();
+
+    if (ok && LittleFS.rename(temporaryFile, contentFile))
+        return true;
+    Serial.println("ContentCache: Failed to write content cache");
+    LittleFS.remove(temporaryFile);
+    return false;
+}
+
+void ContentCache::restore()
+{
+    LittleFS.begin(true);
+    File file = LittleFS.open(contentFile, "r");
+    if (!file)
+        return;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    while (file.available())
+    {
+        //id, time, interval, priority, text
+        String line = file.readStringUntil('\n');
+        int fields[4];
+        fields[0] = line.indexOf('\t');
+        for (int i = 1; i < 4 && fields[i - 1] >= 0; i++)
+            fields[i] = line.indexOf('\t', fields[i - 1] + 1);
+        if (fields[0] <= 0 || fields[1] < 0 || fields[2] < 0 || fields[3] < 0)
+            continue;
+
+        Entry entry;
+        entry.timestamp = strtol(line.c_str() + fields[0] + 1, nullptr, 10);
+        entry.intervalMs = strtoul(line.c_str() + fields[1] + 1, nullptr, 10);
+        entry.priority = strtoul(line.c_str() + fields[2] + 1, nullptr, 10);
+        entry.text = unescape(line.c_str() + fields[3] + 1, line.c_str() + line.length());
+        std::string id = unescape(line.c_str(), line.c_str() + fields[0]);
+
+        //shown with the time it was current, until the source publishes again
+        char age[24] = " (old)";
+        struct tm local;
+        if (entry.timestamp > CLOCK_SET_AFTER && localtime_r(&entry.timestamp, &local))
+            strftime(age, sizeof(age), " (%d.%m. %H:%M)", &local);
+
+        ContentItem item;
+        item.id = id;
+        item.text = entry.text + age;
+        item.intervalMs = entry.intervalMs;
+        item.priority = entry.priority;
+        Compositor::getInstance().publish(item);
+
+        entries[id] = entry;
+    }
+    file.close();
+    Serial.printf("ContentCache: Restored %u items\n", (unsigned)entries.size());
+    xSemaphoreGive(mutex);
+}
@@ -1,16 +1,22 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <create_tasks.h>
+#include <metrics.hpp>
 
 void blink_led_task(void *pvParameter);
 
 void create_tasks() {
+#if !EVENT_LOOP_MODE
+  TaskHandle_t handle = NULL;
   xTaskCreate(
       blink_led_task,   // Task function
       "Blink LED Task", // Name of the task
       1024,            // Stack size (in words, not bytes)
       NULL,            // Task input parameter
       1,               // Priority of the task
-      NULL             // Task handle
+      &handle          // Task handle
   );
+  Metrics::getInstance().addTask(handle, 1024);
+#endif
 }   
\ No newline at end of file
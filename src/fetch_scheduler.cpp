@@ -0,0 +1,214 @@
+#include <fetch_scheduler.hpp>
+#include <http_utils.hpp>
+#include <metrics.hpp>
+
+#include <Arduino.h>
+#include <algorithm>
+
+FetchScheduler::FetchScheduler()
+{
+    mutex = xSemaphoreCreateMutex();
+}
+
+void FetchScheduler::begin(bool runOnCaller)
+{
+    if (started)
+        return;
+    started = true;
+
+    //add() and fetchNow() then wake the caller
+    if (runOnCaller)
+        task = xTaskGetCurrentTaskHandle();
+    else
+    {
+        xTaskCreate(scheduler_task_function, "FetchScheduler", 8192, this, 1, &task);
+        Metrics::getInstance().addTask(task, 8192);
+    }
+}
+
+void FetchScheduler::add(const FetchSource& source)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Entry entry{source, xTaskGetTickCount(), false, false, Status{}};
+    entry.status.name = source.name;
+    entries.push_back(entry);
+    push(entries.size() - 1);
+    xSemaphoreGive(mutex);
+
+    if (task)
+        xTaskNotifyGive(task);
+}
+
+void FetchScheduler::fetchNow(const std::string& name)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto& entry : entries)
+    {
+        if (entry.source.name != name)
+            continue;
+
+        if (entry.running)
+            entry.rerun = true;
+        else
+        {
+            entry.due = xTaskGetTickCount();
+            reschedule();
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    if (task)
+        xTaskNotifyGive(task);
+}
+
+std::vector<FetchScheduler::Status> FetchScheduler::getStatus()
+{
+    TickType_t now = xTaskGetTickCount();
+    std::vector<Status> result;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (const auto& entry : entries)
+    {
+        Status status = entry.status;
+        status.nextDueMs = entry.running ? -1 : int32_t(entry.due - now) * int32_t(portTICK_PERIOD_MS);
+        result.push_back(status);
+    }
+    xSemaphoreGive(mutex);
+
+    return result;
+}
+
+//heap order, true when a is due after b (ticks compared wrap-safe)
+bool FetchScheduler::later(size_t a, size_t b) const
+{
+    return int32_t(entries[a].due - entries[b].due) > 0;
+}
+
+void FetchScheduler::push(size_t index)
+{
+    heap.push_back(index);
+    std::push_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+}
+
+//after a due time changed in place
+void FetchScheduler::reschedule()
+{
+    std::make_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+}
+
+//the pooled connections are the first thing to give up when a fetch is short of heap
+bool FetchScheduler::waitForHeap(Entry& entry)
+{
+    if (entry.source.heapNeeded == 0 || ESP.getFreeHeap() >= entry.source.heapNeeded)
+        return true;
+
+    HttpUtils::closeConnections();
+    if (ESP.getFreeHeap() >= entry.source.heapNeeded)
+        return true;
+
+    Serial.printf("FetchScheduler: %s needs %u bytes of heap, %u free, waiting\n",
+        entry.source.name.c_str(), (unsigned)entry.source.heapNeeded, (unsigned)ESP.getFreeHeap());
+    entry.status.heapDeferrals++;
+    return false;
+}
+
+void FetchScheduler::run(size_t index)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Entry& entry = entries[index];
+    if (not waitForHeap(entry))
+    {
+        entry.due = xTaskGetTickCount() + HEAP_RETRY_MS / portTICK_PERIOD_MS;
+        push(index);
+        xSemaphoreGive(mutex);
+        return;
+    }
+
+    //the entry may move while the lock is released, keep what is needed
+    entry.running = true;
+    std::string name = entry.source.name;
+    std::function<bool()> fetch = entry.source.fetch;
+    xSemaphoreGive(mutex);
+
+    uint32_t start = millis();
+    bool ok = fetch();
+    uint32_t duration = millis() - start;
+    Metrics::getInstance().recordDuration(("fetch." + name).c_str(), duration * 1000);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Entry& done = entries[index];
+    const FetchSource& source = done.source;
+    done.running = false;
+    done.status.runs++;
+    done.status.lastDurationMs = duration;
+
+    uint32_t delay;
+    if (ok)
+    {
+        done.status.failures = 0;
+        delay = source.intervalMs;
+    }
+    else
+    {
+        done.status.failures++;
+        done.status.totalFailures++;
+        uint32_t shift = std::min<uint32_t>(done.status.failures - 1, 16);
+        delay = std::min<uint64_t>(uint64_t(source.retryMs) << shift, source.maxBackoffMs);
+    }
+    if (source.jitterMs > 0)
+        delay += random(source.jitterMs + 1);
+
+    if (done.rerun)
+    {
+        done.rerun = false;
+        delay = 0;
+    }
+
+    done.due = xTaskGetTickCount() + delay / portTICK_PERIOD_MS;
+    push(index);
+    Serial.printf("FetchScheduler: %s %s in %u ms, next in %u s\n",
+        name.c_str(), ok ? "done" : "failed", duration, delay / 1000);
+    xSemaphoreGive(mutex);
+}
+
+uint32_t FetchScheduler::poll()
+{
+    int32_t next = -1;
+    uint32_t wait = UINT32_MAX;
+
+    if (not started)
+        return wait;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (not heap.empty())
+    {
+        int32_t remaining = int32_t(entries[heap.front()].due - xTaskGetTickCount());
+        if (remaining <= 0)
+        {
+            std::pop_heap(heap.begin(), heap.end(), [this](size_t a, size_t b) { return later(a, b); });
+            next = heap.back();
+            heap.pop_back();
+        }
+        else
+            wait = remaining * portTICK_PERIOD_MS;
+    }
+    xSemaphoreGive(mutex);
+
+    if (next < 0)
+        return wait;
+
+    run(next);
+    return 0;
+}
+
+void FetchScheduler::scheduler_task_function(void* parameter)
+{
+    FetchScheduler* scheduler = static_cast<FetchScheduler*>(parameter);
+
+    while (true)
+    {
+        uint32_t wait = scheduler->poll();
+        if (wait > 0)   //woken early by add() and fetchNow()
+            ulTaskNotifyTake(pdTRUE, wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait));
+    }
+}
@@ -0,0 +1,139 @@
+#include <frame_mirror.hpp>
+#include <metrics.hpp>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+namespace FrameMirror
+{
+
+static const size_t MAX_FRAME_BYTES = MAX_COLUMNS;  // 8 rows x MAX_COLUMNS / 8 bytes
+static const size_t HEADER_SIZE = 9;                // sync, encoding, counter, columns, length
+
+static Print* output = nullptr;
+static bool useRle = true;
+static TaskHandle_t mirrorTask = nullptr;
+static portMUX_TYPE frameLock = portMUX_INITIALIZER_UNLOCKED;
+
+// written by publish(), read by the mirror task, guarded by frameLock
+static uint8_t pendingFrame[MAX_FRAME_BYTES];
+static uint8_t pendingSegments = 0;
+static uint16_t frameCounter = 0;
+
+// only touched by the render path
+static uint8_t lastFrame[MAX_FRAME_BYTES];
+static size_t lastFrameSize = 0;
+
+static size_t encodeRle(const uint8_t* in, size_t size, uint8_t* out, size_t maxOut)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < size;)
+    {
+        uint8_t value = in[i];
+        size_t run = 1;
+        while (i + run < size && in[i + run] == value && run < 255)
+            run++;
+
+        if (o + 2 > maxOut)
+            return maxOut + 1;  // does not fit, caller falls back to raw
+        out[o++] = run;
+        out[o++] = value;
+        i += run;
+    }
+    return o;
+}
+
+// The packet goes out in one write() call. Serial holds its TX lock for the whole call and every
+// log line takes that lock too (printf formats first and writes once), so a log from a higher
+// priority task can only land between two packets, never inside one.
+static void writePacket(uint8_t encoding, uint16_t counter, uint16_t columns, const uint8_t* payload, uint16_t size)
+{
+    static uint8_t packet[HEADER_SIZE + MAX_COLUMNS + 1];
+
+    uint8_t header[HEADER_SIZE] = {
+        SYNC_0, SYNC_1, encoding,
+        uint8_t(counter), uint8_t(counter >> 8),
+        uint8_t(columns), uint8_t(columns >> 8),
+        uint8_t(size), uint8_t(size >> 8)
+    };
+    memcpy(packet, header, HEADER_SIZE);
+    memcpy(packet + HEADER_SIZE, payload, size);
+
+    uint8_t checksum = 0;
+    for (uint16_t i = 0; i < size; i++)
+        checksum ^= payload[i];
+    packet[HEADER_SIZE + size] = checksum;
+
+    output->write(packet, HEADER_SIZE + size + 1);
+}
+
+static void mirror_task_function(void* parameter)
+{
+    static uint8_t frame[MAX_FRAME_BYTES];
+    static uint8_t columnBytes[MAX_COLUMNS];
+    static uint8_t rle[MAX_COLUMNS];
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        taskENTER_CRITICAL(&frameLock);
+        uint8_t segments = pendingSegments;
+        uint16_t counter = frameCounter;
+        memcpy(frame, pendingFrame, segments * 8);
+        taskEXIT_CRITICAL(&frameLock);
+
+        //row-major frame buffer to column bytes, done here to keep the render path cheap
+        uint16_t columns = segments * 8;
+        for (uint16_t x = 0; x < columns; x++)
+        {
+            uint8_t col = 0;
+            for (uint8_t y = 0; y < 8; y++)
+            {
+                if (frame[y * segments + (x >> 3)] & (0x80 >> (x & 7)))
+                    col |= 1 << y;
+            }
+            columnBytes[x] = col;
+        }
+
+        size_t rleSize = useRle ? encodeRle(columnBytes, columns, rle, sizeof(rle)) : columns;
+        if (rleSize < columns)
+            writePacket(ENCODING_RLE, counter, columns, rle, rleSize);
+        else
+            writePacket(ENCODING_RAW, counter, columns, columnBytes, columns);
+    }
+}
+
+void begin(Print& out, bool rle)
+{
+    output = &out;
+    useRle = rle;
+    if (mirrorTask == nullptr)
+    {
+        xTaskCreate(mirror_task_function, "FrameMirror", 2048, nullptr, tskIDLE_PRIORITY, &mirrorTask);
+        Metrics::getInstance().addTask(mirrorTask, 2048);
+    }
+}
+
+void publish(const uint8_t* frameBuffer, uint8_t segments)
+{
+    size_t size = segments * 8;
+    if (mirrorTask == nullptr || size > MAX_FRAME_BYTES)
+        return;
+
+    if (size == lastFrameSize && memcmp(frameBuffer, lastFrame, size) == 0)
+        return;
+
+    memcpy(lastFrame, frameBuffer, size);
+    lastFrameSize = size;
+
+    taskENTER_CRITICAL(&frameLock);
+    memcpy(pendingFrame, frameBuffer, size);
+    pendingSegments = segments;
+    frameCounter++;
+    taskEXIT_CRITICAL(&frameLock);
+
+    xTaskNotifyGive(mirrorTask);
+}
+
+} // namespace FrameMirror
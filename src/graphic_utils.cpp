@@ -2,7 +2,11 @@
 #include <freertos/FreeRTOS.h>
 #include "graphic_utils.hpp"
 #include <resource_manager.hpp>
+#include <strip_cache.hpp>
+#include <animation.hpp>
+#include <packed_rows.hpp>
 #include <memory>
+#include <algorithm>
 
 ResourceManager<LMDS> displayManager;
 
@@ -11,77 +15,149 @@ void copyCanvasToDisplay(GFXcanvas1 &canvas, uint16_t canvasOffset, LMDS &displa
   int w = std::min(canvas.width(), display.width());
   int h = std::min(canvas.height(), display.height());
 
-  for (int x = 0; x < w; x++)
+  //both buffers are packed 1bpp rows, MSB first, so whole bytes can be moved at once
+  blitPackedRows(canvas.getBuffer(), (canvas.width() + 7) / 8, canvas.width(), canvasOffset,
+                 display.rowPtr(0), display.getSegments(), display.width(), displayOffset,
+                 w, h);
+}
+
+void copyStripToDisplay(const uint8_t *columns, int stripWidth, int stripOffset, LMDS &display, int16_t displayOffset)
+{
+  int w = std::min<int>(stripWidth, display.width());
+  int lo = std::max<int>(displayOffset, 0);
+  int hi = std::min<int>(displayOffset + w, display.width());
+  if (lo >= hi)
+    return;
+
+  //transpose column bytes into the row-major frame buffer, 8 columns at a time
+  for (int b = lo >> 3; b <= (hi - 1) >> 3; b++)
   {
-    uint8_t col = 0;
-    for (int y = 0; y < h; y++)
+    uint8_t rows[8] = {};
+    uint8_t mask = 0;
+    for (int bit = 0; bit < 8; bit++)
     {
-      bool v = canvas.getPixel(x + canvasOffset, y);
-      display.setPixel(x + displayOffset, y, v);
+      int x = b * 8 + bit;
+      if (x < lo || x >= hi)
+        continue;
+      mask |= 0x80 >> bit;
+
+      int sx = x - displayOffset + stripOffset;
+      uint8_t col = (sx >= 0 && sx < stripWidth) ? columns[sx] : 0;
+      for (int y = 0; col; y++, col >>= 1)
+        if (col & 1)
+          rows[y] |= 0x80 >> bit;
+    }
+
+    for (int y = 0; y < 8; y++)
+    {
+      uint8_t *p = display.rowPtr(y) + b;
+      *p = (*p & ~mask) | rows[y];
     }
   }
 }
 
-//put it here to avoid reallocation on each call
-//and it can be bigger as well because it doesn't belng to any task stack
-static GFXcanvas1 canvas(512, 8);
+class ScrollAnimation : public Animation
+{
+public:
+  ScrollAnimation(const uint8_t *columns, int stripWidth, int displayWidth, int steps)
+      : columns(columns), stripWidth(stripWidth), steps(steps),
+        frames((stripWidth - displayWidth + steps) / steps + 1) {}
+
+  uint32_t frameCount() const override { return frames; }
 
+  void renderFrame(LMDS &display, uint32_t frame) override
+  {
+    copyStripToDisplay(columns, stripWidth, frame * steps, display, 0);
+  }
 
+private:
+  const uint8_t *columns;
+  int stripWidth;
+  int steps;
+  uint32_t frames;
+};
 
+class WipeAnimation : public Animation
+{
+public:
+  WipeAnimation(LMDS &display) : frames(display.width()) {}
 
-void scrollMessage(std::string message, LMDS& display, int speed, int steps)
-{ 
-  auto msgLength = message.size();
-  static const int FONT_WIDTH = 6; //5 pixels + 1 pixel space
+  uint32_t frameCount() const override { return frames; }
+
+  void renderFrame(LMDS &display, uint32_t frame) override
+  {
+    //clear every column up to the requested one, catches up with skipped frames
+    for (; wiped <= frame; wiped++)
+      display.setColumn(wiped, 0x00);
+  }
+
+private:
+  uint32_t frames;
+  uint32_t wiped = 0;
+};
+
+class ScrollOutAnimation : public Animation
+{
+public:
+  ScrollOutAnimation(LMDS &display) : frames(display.width()) {}
+
+  uint32_t frameCount() const override { return frames; }
+
+  void renderFrame(LMDS &display, uint32_t frame) override
+  {
+    for (; scrolled <= frame; scrolled++)
+      display.scroll(LMDS::scrollDirection::scrollRight);
+  }
 
-  Serial.printf("Scrolling message: '%s', length: %d\n", message.c_str(), msgLength);
+private:
+  uint32_t frames;
+  uint32_t scrolled = 0;
+};
+
+void showStrip(const MessageStrip& strip, LMDS& display, int speed, int steps, const std::function<bool()>& stop)
+{
+  const uint8_t *columns = strip.columns.data();
+  int stripWidth = strip.width();
 
   //center shorter messages
-  if (msgLength * FONT_WIDTH <= display.width())
+  if (stripWidth <= display.width())
   {
     Serial.println("Message fits on the display, centering");
     //message fits on the display, no need to scroll, but center the message
     display.clear();
-    int offset = (display.width() - msgLength) / 2;
-    copyCanvasToDisplay(canvas, 0, display, offset);
-    display.displayToSerial(Serial);
+    copyStripToDisplay(columns, stripWidth, 0, display, (display.width() - stripWidth) / 2);
+    display.present();
     vTaskDelay(10 * speed / portTICK_PERIOD_MS);
     return;
   }
 
-  GFXcanvas1 canvas(msgLength * FONT_WIDTH, 8);
-  canvas.print(message.c_str());
-
   vTaskDelay(10 * speed / portTICK_PERIOD_MS);
 
-  for (int i = 0; i <= canvas.width() - display.width() + steps; i += steps)
-  {
-    copyCanvasToDisplay(canvas, i, display, 0);
-    display.displayToSerial(Serial);
-    vTaskDelay(speed / portTICK_PERIOD_MS);
-  }
+  ScrollAnimation scroll(columns, stripWidth, display.width(), steps);
+  runAnimation(scroll, display, speed, stop);
   
   vTaskDelay(10 * speed / portTICK_PERIOD_MS);
 }
 
+void scrollMessage(std::string message, LMDS& display, int speed, int steps)
+{ 
+  //the strip is rendered once and shared by all later calls with the same text
+  auto strip = StripCache::getInstance().get(message);
+
+  Serial.printf("Scrolling message: '%s', length: %d\n", message.c_str(), message.size());
+  showStrip(*strip, display, speed, steps);
+}
+
 void wipeDisplayLeftToRight(LMDS& display, int speed)
 {
   //assume you already have access to the display
-  for (int col = 0; col < display.getSegments() * 8; col++)
-  {
-    display.setColumn(col, 0x00);
-    display.displayToSerial(Serial);
-    vTaskDelay(speed / portTICK_PERIOD_MS);
-  }
+  WipeAnimation wipe(display);
+  runAnimation(wipe, display, speed);
 }
 
 void scrollOutDisplayRight(LMDS& display, int speed)
 {
   //assume you already have access to the display
-  for (int col = 0; col < display.getSegments() * 8; col++)
-  {
-    display.scroll(LMDS::scrollDirection::scrollRight);
-    display.displayToSerial(Serial);
-    vTaskDelay(speed / portTICK_PERIOD_MS);
-  }
-}
\ No newline at end of file
+  ScrollOutAnimation scrollOut(display);
+  runAnimation(scrollOut, display, speed);
+}
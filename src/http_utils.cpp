@@ -1,60 +1,488 @@
 // http_utils.cpp
 //
 // Simple HTTP(S) helper for ESP32 / PlatformIO projects.
-// Provides a small wrapper to perform GET requests and return response body and status.
+// Provides a small wrapper to perform GET requests and return response body and status,
+// or to stream the body into a sink without buffering it. Connections are kept alive
+// and reused per host, gzip and deflate bodies are decompressed on the fly.
 
 #include <Arduino.h>
 #include <HTTPClient.h>
 #include <WiFiClient.h>
 #include <WiFiClientSecure.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <LittleFS.h>
+#include <map>
 #include <memory>
+#include <string>
+#include <algorithm>
+#include <http_utils.hpp>
+#include <inflate_sink.hpp>
+#include <metrics.hpp>
 
 namespace HttpUtils {
 
-/// Perform an HTTP(S) GET.
-/// @param url        Full URL (http:// or https://)
-/// @param outBody    Will be filled with response body on success (empty on failure)
-/// @param insecure   If true and using HTTPS, the TLS certificate will not be verified (useful for testing)
-/// @return HTTP status code (>0) on success, or a negative value on error
-int httpGet(const String &url, String &outBody, bool insecure = true) {
-    outBody = String();
+// Collects the whole body, used by the String based httpGet
+class StringSink : public HttpSink
+{
+public:
+    StringSink(String &body) : body(body) {}
 
-    if (url.length() == 0) {
-        return -1;
+    bool onResponse(int status, int contentLength, HTTPClient &http) override
+    {
+        if (contentLength > 0)
+            body.reserve(contentLength);
+        return true;
     }
 
-    HTTPClient http;
-    std::unique_ptr<WiFiClient> plainClient;
-    std::unique_ptr<WiFiClientSecure> secureClient;
-    int result = -1;
+    bool onData(const uint8_t *data, size_t len) override
+    {
+        body.concat((const char *)data, len);
+        return true;
+    }
+
+private:
+    String &body;
+};
+
+// Reads `len` bytes (or until the connection closes when len < 0) and passes them to the sink,
+// a satisfied sink no longer sees them. Returns 0 when done, 1 when the sink aborted, or a negative error.
+static int pumpBody(WiFiClient &stream, HttpSink &sink, int len, uint8_t *buffer, size_t bufferSize)
+{
+    while (len != 0)
+    {
+        size_t wanted = (len < 0) ? bufferSize : std::min<size_t>(len, bufferSize);
+        if (len < 0 && not stream.connected() && stream.available() == 0)
+            return 0;   // close-delimited body is complete
+
+        size_t got = stream.readBytes(buffer, wanted);
+        if (got == 0)
+            return (len < 0 && not stream.connected()) ? 0 : HTTPC_ERROR_READ_TIMEOUT;
+
+        if (not sink.satisfied() && not sink.onData(buffer, got))
+            return 1;
+        if (len > 0)
+            len -= got;
+    }
+    return 0;
+}
 
-    // Choose client based on scheme
-    if (url.startsWith("https://")) {
-        secureClient = std::unique_ptr<WiFiClientSecure>(new WiFiClientSecure());
-        if (insecure) {
-            // Skip certificate validation (NOT recommended for production)
-            secureClient->setInsecure();
+// Decodes a chunked body: hex size line, data, CRLF, ... terminated by a zero sized chunk
+static int pumpChunkedBody(WiFiClient &stream, HttpSink &sink, uint8_t *buffer, size_t bufferSize)
+{
+    char line[24];
+    while (true)
+    {
+        size_t n = stream.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[n] = '\0';
+        if (n == 0)
+            return HTTPC_ERROR_READ_TIMEOUT;
+
+        int chunkSize = strtol(line, nullptr, 16);
+        if (chunkSize == 0)
+        {
+            // skip trailers up to the empty line
+            while (stream.readBytesUntil('\n', line, sizeof(line) - 1) > 1) {}
+            return 0;
         }
-        http.begin(*secureClient, url);
-    } else {
-        plainClient = std::unique_ptr<WiFiClient>(new WiFiClient());
-        http.begin(*plainClient, url);
+
+        int result = pumpBody(stream, sink, chunkSize, buffer, bufferSize);
+        if (result != 0)
+            return result;
+
+        // CRLF after the chunk data
+        stream.readBytesUntil('\n', line, sizeof(line) - 1);
     }
+}
 
-    // Perform GET
-    int httpCode = http.GET();
-    if (httpCode > 0) {
-        // success, read response
-        outBody = http.getString();
-        result = httpCode;
-    } else {
+// One kept-alive connection, the HTTPClient stays bound to its client between requests
+struct PoolEntry
+{
+    String origin;      // scheme://host[:port]
+    bool insecure = false;
+    std::unique_ptr<WiFiClient> client;
+    std::unique_ptr<HTTPClient> http;
+    TickType_t lastUsed = 0;
+};
+
+// Keeps up to POOL_SIZE connections open. The mutex is held for a whole request,
+// so requests are serialized and at most one handshake is in flight at any time.
+class ConnectionPool
+{
+public:
+    static ConnectionPool& getInstance()
+    {
+        static ConnectionPool instance;
+        return instance;
+    }
+
+    void lock() { xSemaphoreTake(mutex, portMAX_DELAY); }
+    void unlock() { xSemaphoreGive(mutex); }
+
+    // The entry for the url's origin, a new one takes an empty or the least recently used slot.
+    // Call with the lock held.
+    PoolEntry& acquire(const String& url, bool insecure)
+    {
+        TickType_t now = xTaskGetTickCount();
+        String origin = originOf(url);
+
+        PoolEntry* victim = nullptr;
+        for (auto& entry : entries)
+        {
+            if (entry.http && (now - entry.lastUsed) * portTICK_PERIOD_MS > POOL_IDLE_TIMEOUT_MS)
+                discard(entry);
+
+            if (entry.http && entry.insecure == insecure && entry.origin == origin)
+                return entry;
+
+            if (victim == nullptr || (victim->http && (not entry.http || int32_t(entry.lastUsed - victim->lastUsed) < 0)))
+                victim = &entry;
+        }
+
+        discard(*victim);
+        victim->origin = origin;
+        victim->insecure = insecure;
+        if (url.startsWith("https://")) {
+            WiFiClientSecure *secure = new WiFiClientSecure();
+            if (insecure) {
+                // Skip certificate validation (NOT recommended for production)
+                secure->setInsecure();
+            }
+            victim->client.reset(secure);
+        } else {
+            victim->client.reset(new WiFiClient());
+        }
+        victim->http.reset(new HTTPClient());
+        victim->http->setReuse(true);
+        victim->lastUsed = now;
+        return *victim;
+    }
+
+    void discard(PoolEntry& entry)
+    {
+        if (entry.http)
+        {
+            entry.http->setReuse(false);
+            entry.http->end();
+        }
+        if (entry.client)
+            entry.client->stop();
+
+        // the HTTPClient points at the client, so it goes first
+        entry.http.reset();
+        entry.client.reset();
+        entry.origin = String();
+    }
+
+    void closeAll()
+    {
+        lock();
+        for (auto& entry : entries)
+            discard(entry);
+        unlock();
+    }
+
+    void record(bool reused, bool retried, int result, uint32_t latencyMs)
+    {
+        taskENTER_CRITICAL(&statsLock);
+        stats.requests++;
+        if (reused)
+            stats.handshakesAvoided++;
+        else
+            stats.connects++;
+        if (retried)
+            stats.retries++;
+        if (result <= 0)
+            stats.errors++;
+        else
+            (reused ? stats.reused : stats.fresh).add(latencyMs);
+        taskEXIT_CRITICAL(&statsLock);
+    }
+
+    void recordCompression(size_t compressedBytes, size_t decompressedBytes)
+    {
+        taskENTER_CRITICAL(&statsLock);
+        stats.compressedResponses++;
+        stats.compressedBytes += compressedBytes;
+        stats.decompressedBytes += decompressedBytes;
+        taskEXIT_CRITICAL(&statsLock);
+    }
+
+    HttpStats getStats()
+    {
+        taskENTER_CRITICAL(&statsLock);
+        HttpStats copy = stats;
+        taskEXIT_CRITICAL(&statsLock);
+        return copy;
+    }
+
+private:
+    ConnectionPool()
+    {
+        mutex = xSemaphoreCreateMutex();
+        portMUX_INITIALIZE(&statsLock);
+    }
+
+    static String originOf(const String& url)
+    {
+        int schemeEnd = url.indexOf("://");
+        int pathStart = url.indexOf('/', schemeEnd < 0 ? 0 : schemeEnd + 3);
+        return pathStart < 0 ? url : url.substring(0, pathStart);
+    }
+
+    PoolEntry entries[POOL_SIZE];
+    SemaphoreHandle_t mutex;
+    portMUX_TYPE statsLock;
+    HttpStats stats;
+};
+
+static const char validatorFile[] = "/http_validators.txt";
+
+// ETag / Last-Modified per URL, kept in LittleFS so they survive a reboot.
+// Only used under the pool lock, so it needs no locking of its own.
+class ValidatorCache
+{
+public:
+    struct Validators
+    {
+        String etag;
+        String lastModified;
+    };
+
+    static ValidatorCache& getInstance()
+    {
+        static ValidatorCache instance;
+        return instance;
+    }
+
+    const Validators* find(const String& url)
+    {
+        load();
+        auto it = validators.find(url.c_str());
+        return it != validators.end() ? &it->second : nullptr;
+    }
+
+    void update(const String& url, const String& etag, const String& lastModified)
+    {
+        load();
+        //servers that send neither don't get an entry
+        if (etag.length() == 0 && lastModified.length() == 0 && validators.count(url.c_str()) == 0)
+            return;
+        Validators& entry = validators[url.c_str()];
+        if (entry.etag == etag && entry.lastModified == lastModified)
+            return;
+
+        entry.etag = etag;
+        entry.lastModified = lastModified;
+        dirty = true;
+        save();
+    }
+
+    // Writes the file when something changed and the last write is long enough ago,
+    // a change that is not written yet goes out with a later request
+    void save()
+    {
+        if (not dirty || (saved && millis() - lastSave < VALIDATOR_SAVE_INTERVAL_MS))
+            return;
+
+        LittleFS.begin(true);
+        File file = LittleFS.open(validatorFile, "w");
+        if (!file) {
+            Serial.println("HTTP: Failed to write validator cache");
+            return;
+        }
+        for (const auto& entry : validators)
+            file.printf("%s\t%s\t%s\n", entry.first.c_str(), entry.second.etag.c_str(), entry.second.lastModified.c_str());
+        file.close();
+
+        dirty = false;
+        saved = true;
+        lastSave = millis();
+    }
+
+private:
+    ValidatorCache() = default;
+
+    void load()
+    {
+        if (loaded)
+            return;
+        loaded = true;
+
+        LittleFS.begin(true);
+        File file = LittleFS.open(validatorFile, "r");
+        if (!file)
+            return;
+
+        while (file.available())
+        {
+            String line = file.readStringUntil('\n');
+            int first = line.indexOf('\t');
+            int second = line.indexOf('\t', first + 1);
+            if (first <= 0 || second < 0)
+                continue;
+
+            Validators& entry = validators[line.substring(0, first).c_str()];
+            entry.etag = line.substring(first + 1, second);
+            entry.lastModified = line.substring(second + 1);
+        }
+        file.close();
+        Serial.printf("HTTP: Loaded validators for %u URLs\n", (unsigned)validators.size());
+    }
+
+    std::map<std::string, Validators> validators;
+    bool loaded = false;
+    bool dirty = false;
+    bool saved = false;
+    uint32_t lastSave = 0;
+};
+
+/// Perform an HTTP(S) GET and stream the body into a sink.
+/// @param url         Full URL (http:// or https://)
+/// @param sink        Receives status, headers and the body in pieces of at most STREAM_BUFFER_SIZE bytes
+/// @param insecure    If true and using HTTPS, the TLS certificate will not be verified (useful for testing)
+/// @param headerKeys  Response headers to collect, available through http.header() in sink.onResponse()
+/// @param conditional Send the validators of the last response for this url, an unchanged resource
+///                    then returns HTTP_CODE_NOT_MODIFIED without calling the sink
+/// @return HTTP status code (>0) on success, or a negative HTTPC_ERROR_* value on error
+int httpGetStream(const String &url, HttpSink &sink, bool insecure, const char *headerKeys[], size_t headerCount,
+                  bool conditional) {
+    if (url.length() == 0) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    // Transfer-Encoding and Content-Encoding are needed to decode the body, the validators for the
+    // next conditional request, the rest is up to the caller. The validators are kept for every
+    // url, so a conditional request can follow a plain one
+    const size_t maxKeys = 12;
+    const char *keys[maxKeys];
+    size_t keyCount = 0;
+    keys[keyCount++] = "Transfer-Encoding";
+    keys[keyCount++] = "Content-Encoding";
+    keys[keyCount++] = "ETag";
+    keys[keyCount++] = "Last-Modified";
+    for (size_t i = 0; i < headerCount && keyCount < maxKeys; i++)
+        keys[keyCount++] = headerKeys[i];
+
+    auto &pool = ConnectionPool::getInstance();
+    auto &cache = ValidatorCache::getInstance();
+    pool.lock();
+    uint32_t start = millis();
+    const ValidatorCache::Validators *validators = conditional ? cache.find(url) : nullptr;
+
+    PoolEntry *entry = nullptr;
+    bool reused = false;
+    bool retried = false;
+    int httpCode = 0;
+    while (true) {
+        entry = &pool.acquire(url, insecure);
+        reused = entry->client->connected();
+
+        entry->http->begin(*entry->client, url);
+        entry->http->collectHeaders(keys, keyCount);
+        entry->http->setAcceptEncoding("gzip, deflate");
+        if (validators && validators->etag.length() > 0)
+            entry->http->addHeader("If-None-Match", validators->etag);
+        if (validators && validators->lastModified.length() > 0)
+            entry->http->addHeader("If-Modified-Since", validators->lastModified);
+        httpCode = entry->http->GET();
+
+        if (httpCode > 0 || not reused || retried)
+            break;
+
+        // the server closed the idle connection in the meantime, try once more on a new one
+        pool.discard(*entry);
+        retried = true;
+    }
+
+    if (httpCode <= 0) {
         // error during connection/request
-        result = -httpCode; // return negative of error (<=0)
+        pool.discard(*entry);
+        pool.record(reused, retried, httpCode, 0);
+        pool.unlock();
+        return httpCode;
     }
 
+    HTTPClient &http = *entry->http;
+    int result = httpCode;
+    int pumped = 1;
+
+    // the sink gets the decompressed body, its length is not known up front
+    String encoding = http.header("Content-Encoding");
+    std::unique_ptr<InflateSink> inflate;
+    if (encoding.equalsIgnoreCase("gzip") || encoding.equalsIgnoreCase("deflate"))
+        inflate = std::unique_ptr<InflateSink>(new InflateSink(sink, encoding.equalsIgnoreCase("gzip")));
+
+    if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+        // no body follows, the caller keeps what it has
+        pumped = 0;
+    } else if (sink.onResponse(httpCode, inflate ? -1 : http.getSize(), http)) {
+        uint8_t buffer[STREAM_BUFFER_SIZE];
+        WiFiClient &stream = *http.getStreamPtr();
+        HttpSink &target = inflate ? *inflate : sink;
+
+        pumped = http.header("Transfer-Encoding").equalsIgnoreCase("chunked")
+            ? pumpChunkedBody(stream, target, buffer, sizeof(buffer))
+            : pumpBody(stream, target, http.getSize(), buffer, sizeof(buffer));
+
+        if (pumped < 0)
+            result = pumped;
+        else if (inflate)
+            result = inflate->result(result);
+    }
+
+    // remember the validators of a complete response only, a partial one must be fetched again
+    if (result == HTTP_CODE_OK && pumped == 0)
+        cache.update(url, http.header("ETag"), http.header("Last-Modified"));
+    else
+        cache.save();
+
+    // a body that was not read to the end leaves the connection unusable
+    if (pumped != 0)
+        http.setReuse(false);
     http.end();
+    http.setReuse(true);
+    entry->lastUsed = xTaskGetTickCount();
+
+    uint32_t latency = millis() - start;
+    pool.record(reused, retried, result, latency);
+    Metrics::getInstance().recordDuration("http", latency * 1000);
+    if (inflate) {
+        pool.recordCompression(inflate->compressedBytes(), inflate->decompressedBytes());
+        Serial.printf("HTTP: GET %s -> %d in %u ms (%s, %s %u -> %u bytes)\n", entry->origin.c_str(), result, latency,
+                      reused ? "reused connection" : "new connection", encoding.c_str(),
+                      (unsigned)inflate->compressedBytes(), (unsigned)inflate->decompressedBytes());
+    } else {
+        Serial.printf("HTTP: GET %s -> %d in %u ms (%s)\n", entry->origin.c_str(), result, latency,
+                      reused ? "reused connection" : "new connection");
+    }
+    inflate.reset();
+    pool.unlock();
+
+    return result;
+}
+
+HttpStats getStats() {
+    return ConnectionPool::getInstance().getStats();
+}
+
+void closeConnections() {
+    ConnectionPool::getInstance().closeAll();
+}
+
+/// Perform an HTTP(S) GET.
+/// @param url        Full URL (http:// or https://)
+/// @param outBody    Will be filled with response body on success (empty on failure)
+/// @param insecure   If true and using HTTPS, the TLS certificate will not be verified (useful for testing)
+/// @param conditional Only fetch the body when it changed since the last call, see httpGetStream()
+/// @return HTTP status code (>0) on success, or a negative value on error
+int httpGet(const String &url, String &outBody, bool insecure, bool conditional) {
+    outBody = String();
 
-    // unique_ptr cleans up automatically
+    StringSink sink(outBody);
+    int result = httpGetStream(url, sink, insecure, nullptr, 0, conditional);
+    if (result <= 0)
+        outBody = String();
     return result;
 }
 
@@ -1,6 +1,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <Arduino.h>
+#include <create_tasks.h>
 
 static const int LED = 8;
 
@@ -12,4 +13,25 @@ void blink_led_task(void *pvParameter) {
     digitalWrite(LED, LOW);
     vTaskDelay(1000 / portTICK_PERIOD_MS);
   }
-}
\ No newline at end of file
+}
+
+uint32_t blink_led_poll() {
+  static bool started = false;
+  static bool on = false;
+  static uint32_t next = 0;
+
+  if (!started) {
+    pinMode(LED, OUTPUT);
+    next = millis();
+    started = true;
+  }
+
+  int32_t remaining = (int32_t)(next - millis());
+  if (remaining > 0)
+    return remaining;
+
+  on = !on;
+  digitalWrite(LED, on ? HIGH : LOW);
+  next += 1000;
+  return 1000;
+}
@@ -4,123 +4,105 @@
 #include <http_utils.hpp>
 #include <resource_manager.hpp>
 #include <LMDS.hpp>
-#include <graphic_utils.hpp>
+#include <compositor.hpp>
+#include <content_cache.hpp>
+#include <fetch_scheduler.hpp>
+#include <metrics.hpp>
+#include <esp_timer.h>
+#include <lhc_field_extractor.hpp>
 #include <data_store.hpp>
-#include <string_utils.h>
 #include <string>
 
 static const char pageUrl[] PROGMEM = "https://alicedcs.web.cern.ch/monitoring/screenshots/rss.xml";
 
-static std::map<std::string, std::string> interesting_fields =
+// The extractor as the body sink of the HTTP request
+class LhcFieldSink : public HttpUtils::HttpSink
 {
-    {"LhcPage1", ""},
-    {"LhcBeamMode", ""},
-    {"BeamEnergy", ""},
-    {"LhcMachineMode", ""}
-};
-
-void remoteHTMLTags(String& str)
-{
-    str.replace("<br>", "--");
-    str.replace("<br/>", "--");
-}
-
-void lhc_status_task(void *parameter)
-{
-    std::string modeAndEnergyMessage;
-    std::string page1Message;
-
-    time_t last_update = 0;
-
-    auto& rmd = ResourceManager<LMDS>::getInstance();
-    auto& matrix = rmd.getResourceRef();
+public:
+    LhcFieldSink(LhcFieldExtractor& extractor) : extractor(extractor) {}
 
-    while (true)
+    bool onData(const uint8_t* data, size_t len) override
     {
-        if (difftime(time(nullptr), last_update) > 30)
-        {
-            String output;
-            auto response = HttpUtils::httpGet(pageUrl, output, true);
-            if (response != 200)
-            {
-                Serial.printf("LHCStatus: HTTP GET failed, response: %d\n", response);
-                vTaskDelay(60000 / portTICK_PERIOD_MS); // wait a minute before
-                continue;
-            }      
-            
-            bool fields_updated = false;
+        extractor.feed(data, len);
+        return true;
+    }
 
-            StringViewStream svs(output);  
-            while (svs.available())
-            {
-                String line = svs.readStringUntil('\n');
-                line.trim();
-                if (not line.startsWith("<title>"))
-                    continue; //line doesn't contain what we want
-                
-                int colonIndex = line.indexOf(':');
-                if (colonIndex == -1)
-                    continue; //the line has no colon, skip it too
+    bool satisfied() const override
+    {
+        return extractor.satisfied();
+    }
 
-                //extract title
-                String title = line.substring(0, colonIndex);
-                title.replace("<title>", "");
+private:
+    LhcFieldExtractor& extractor;
+};
 
-                //if the title is one of the interesting fields, extract the value and save back to the map
-                if (interesting_fields.find(title.c_str()) != interesting_fields.end())
-                {
-                    String value = line.substring(colonIndex + 1);
-                    remoteHTMLTags(value);
-                    value.replace("</title>", "");
-                    value.trim();
-                    interesting_fields[title.c_str()] = value.c_str();
-                    Serial.printf("LHCStatus: %s = %s\n", title.c_str(), value.c_str());
-                    fields_updated = true;
-                }
-            }
+static void publishLhcMessage(const char* id, const std::string& text)
+{
+    ContentItem item;
+    item.id = id;
+    item.text = text;
+    item.intervalMs = 10000;
+    item.priority = ResourceManager<LMDS>::PRIORITY_LOW;
+    ContentCache::getInstance().publish(item);
+}
 
-            if (fields_updated)
-            {
-                //create message to be displayed
-                char buffer[128];
-                snprintf_P(buffer, sizeof(buffer), PSTR("%s: %s @ %s"),
-                    interesting_fields["LhcMachineMode"].c_str(),
-                    interesting_fields["LhcBeamMode"].c_str(),
-                    interesting_fields["BeamEnergy"].c_str());
-                
-                modeAndEnergyMessage = buffer;
-                    
-                page1Message = interesting_fields["LhcPage1"];
-                last_update = time(nullptr);
-            }
-        }   //end of update block
+//only ask for changes once there is something on the display to keep
+static bool published = false;
 
-        if (not rmd.make_access_request())
-        {
-            Serial.println("LHCStatus: Failed to get access to display");   
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            continue;
-        }
+static bool fetchLhcStatus()
+{
+    LhcFieldExtractor extractor(esp_timer_get_time);
+    LhcFieldSink sink(extractor);
+    auto response = HttpUtils::httpGetStream(pageUrl, sink, true, nullptr, 0, published);
+    if (response == HTTP_CODE_OK)
+        Metrics::getInstance().recordDuration("parse.lhc", extractor.parseTimeUs());
+    if (response == HTTP_CODE_NOT_MODIFIED)
+        return true;
+    if (response != 200)
+    {
+        Serial.printf("LHCStatus: HTTP GET failed, response: %d\n", response);
+        return false;
+    }
 
-        if (not modeAndEnergyMessage.empty())
+    //a field missing from a response keeps the value of the last one that had it
+    static std::string values[LhcFieldExtractor::FIELD_COUNT];
+    for (int i = 0; i < LhcFieldExtractor::FIELD_COUNT; i++)
+    {
+        auto field = LhcFieldExtractor::Field(i);
+        if (extractor.found(field))
         {
-            scrollMessage(modeAndEnergyMessage, matrix, 50);
+            values[field] = extractor.value(field);
+            Serial.printf("LHCStatus: %s = %s\n", extractor.key(field), extractor.value(field));
         }
-        rmd.release_access();
+    }
 
-        vTaskDelay(5000 / portTICK_PERIOD_MS);
-        if (not rmd.make_access_request())
-        {
-            Serial.println("LHCStatus: Failed to get access to display");   
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            continue;
-        }
-        if (not page1Message.empty())
-        {
-            Serial.printf("LHCStatus: Displaying page 1 message: %s\n", page1Message.c_str());
-            scrollMessage(page1Message, matrix, 50);
-        }
-        rmd.release_access();
-        vTaskDelay(5000 / portTICK_PERIOD_MS);
+    if (extractor.foundCount() > 0)
+    {
+        //create message to be displayed
+        char buffer[128];
+        snprintf_P(buffer, sizeof(buffer), PSTR("%s: %s @ %s"),
+            values[LhcFieldExtractor::LhcMachineMode].c_str(),
+            values[LhcFieldExtractor::LhcBeamMode].c_str(),
+            values[LhcFieldExtractor::BeamEnergy].c_str());
+        
+        //the compositor shows them from now on, the display is never locked here
+        publishLhcMessage("lhc_mode", buffer);
+        if (not values[LhcFieldExtractor::LhcPage1].empty())
+            publishLhcMessage("lhc_page1", values[LhcFieldExtractor::LhcPage1]);
+        published = true;
     }
-}
\ No newline at end of file
+    return true;
+}
+
+void register_lhc_status_source()
+{
+    FetchSource source;
+    source.name = "lhc";
+    source.fetch = fetchLhcStatus;
+    source.intervalMs = 30000;
+    source.jitterMs = 3000;
+    source.retryMs = 60000;
+    source.maxBackoffMs = 600000;
+    source.heapNeeded = 80 * 1024;  // TLS session and gzip window
+    FetchScheduler::getInstance().add(source);
+}
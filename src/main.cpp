@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <WiFiManager.h>
 
 #include <create_tasks.h>
 #include <hardware_init.h>
@@ -7,15 +6,31 @@
 
 #include <LMDS.hpp>
 #include <graphic_utils.hpp>
+#include <strip_cache.hpp>
+#include <frame_mirror.hpp>
+#include <compositor.hpp>
+#include <content_cache.hpp>
+#include <boot_progress.hpp>
+#include <fetch_scheduler.hpp>
+#include <metrics.hpp>
 #include <algorithm>
 
 #include <data_store.hpp>
 
-void open_weather_map_task(void *parameter);
-void lhc_status_task(void *parameter);
+void register_weather_source();
+void register_lhc_status_source();
 
 DataStore& dataStore = DataStore::getInstance();
 
+//settings loop() applies as soon as they change, e.g. with "set" on the serial console
+static DataStore::Key stripCacheBytesKey;
+static EventBits_t configChanged = 0;
+
+static void applyConfig()
+{
+  StripCache::getInstance().setBudget(dataStore.get_int(stripCacheBytesKey, StripCache::DEFAULT_BUDGET));
+}
+
 // void animateDisplay(void *parameter)
 // {
 //   matrix.clear();
@@ -49,82 +64,67 @@ DataStore& dataStore = DataStore::getInstance();
 // }
 
 
-void displayClock(void *parameter)
+// Clock content for the compositor: the time for 3 seconds, then the date for 2 seconds
+void renderClock(LMDS& matrix, uint32_t elapsedMs)
 {
-  auto& rmd = ResourceManager<LMDS>::getInstance();
-  auto& matrix = rmd.getResourceRef();
-
-  while (true)
-  {
-    if (not rmd.make_access_request())
-    {
-      Serial.println("ClockDisplay: Failed to get access to display");
-      vTaskDelay(1000 / portTICK_PERIOD_MS);
-      continue;
-    }
-    
-    //print the time
-    for (int i = 0; i < 3; i++)
-    {
-      matrix.clear();
-
+  matrix.clear();
 
-      time_t now = time(nullptr);
-      struct tm *timeinfo = localtime(&now);
+  time_t now = time(nullptr);
+  struct tm *timeinfo = localtime(&now);
 
-      Serial.printf("Current time: %02d:%02d:%02d\n", timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
-      
-      //print to the matrix centered
-      int16_t x1, y1;
-      uint16_t width, height;
-
-      
-      matrix.getTextBounds("00:00:00", 0, 0, &x1, &y1, &width, &height);
-      matrix.setCursor((matrix.getSegments() * 8 - width) / 2, 0);
-      matrix.printf("%02d:%02d:%02d", timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
-      matrix.displayToSerial(Serial);
+  //placeholder until NTP has set the clock
+  if (not BootProgress::getInstance().timeSet())
+  {
+    matrix.setCursor(2, 0);
+    matrix.print(elapsedMs < 3000 ? "--:--:--" : "----------");
+    return;
+  }
 
-      vTaskDelay(1000 / portTICK_PERIOD_MS);
-    }
+  if (elapsedMs < 3000)
+  {
+    Serial.printf("Current time: %02d:%02d:%02d\n", timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
+    
+    //print to the matrix centered
+    int16_t x1, y1;
+    uint16_t width, height;
 
-    matrix.clear();
+    matrix.getTextBounds("00:00:00", 0, 0, &x1, &y1, &width, &height);
+    matrix.setCursor((matrix.getSegments() * 8 - width) / 2, 0);
+    matrix.printf("%02d:%02d:%02d", timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
+    return;
+  }
 
-    time_t now = time(nullptr);
-    struct tm *timeinfo = localtime(&now);
+  Serial.printf("Current date: %04d-%02d-%02d\n", timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday);
+  
+  matrix.setCursor(2, 0);
+  matrix.printf("%04d-%02d-%02d", timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday);
+}
 
-    Serial.printf("Current date: %04d-%02d-%02d\n", timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday);
-    
-    matrix.setCursor(2, 0);
-    matrix.printf("%04d-%02d-%02d", timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday);
-    matrix.displayToSerial(Serial);
-    
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-    rmd.release_access();
-    
-    // wait a bit before updating again and requesting access again
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-  }
+void publishClock()
+{
+  ContentItem clock;
+  clock.id = "clock";
+  clock.kind = ContentItem::Kind::Render;
+  clock.render = renderClock;
+  clock.framePeriodMs = 1000;
+  clock.durationMs = 5000;
+  clock.intervalMs = 2000;
+  //the clock goes ahead of scrolling content and cuts it short when it lags too much
+  clock.priority = ResourceManager<LMDS>::PRIORITY_HIGH;
+  clock.maxLatenessMs = 10000;
+  Compositor::getInstance().publish(clock);
 }
 
 void marqueeDisplay(void *parameter)
 {  
-  auto& rmd = ResourceManager<LMDS>::getInstance();
-  auto& matrix = rmd.getResourceRef();
-  while (true)
-  {   
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
-    if (not rmd.make_access_request())
-    {
-      Serial.println("MarqueeDisplay: Failed to get access to display");
-      continue;
-    }
-
-
-    scrollMessage("ESP32-C3!", matrix, 50);
-
-    rmd.release_access();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-  }
+  ContentItem marquee;
+  marquee.id = "marquee";
+  marquee.text = "ESP32-C3!";
+  marquee.intervalMs = 500;
+  marquee.priority = ResourceManager<LMDS>::PRIORITY_LOW;
+  Compositor::getInstance().publish(marquee);
+
+  vTaskDelete(nullptr);
 }
 
 void listFiles(const char* dirname) {
@@ -155,26 +155,112 @@ void listFiles(const char* dirname) {
   Serial.println("End of file list");
 }
 
+//typing "metrics" on the serial console dumps the collected metrics, "display" the flush counters,
+//"set key=value" changes a setting and writes it back to the config file
+static void runSerialCommand(String command)
+{
+  command.trim();
+  if (command.startsWith("set "))
+  {
+    int equals = command.indexOf('=');
+    String key = command.substring(4, equals < 0 ? 4 : equals);
+    key.trim();
+    if (equals < 0 || key.length() == 0)
+    {
+      Serial.println("Config: usage: set key=value");
+      return;
+    }
+    String value = command.substring(equals + 1);
+    value.trim();
+    dataStore.set_value(key.c_str(), value.c_str());
+    Serial.printf("Config: %s = %s\n", key.c_str(), value.c_str());
+  }
+  else if (command == "metrics")
+    Metrics::getInstance().dump(Serial);
+  else if (command == "display")
+  {
+    LMDS::FlushStats stats = ResourceManager<LMDS>::getInstance().getResourceRef().getFlushStats();
+    Serial.printf("Display: %u frames, %u full, %u rows sent, %u no-ops, %u SPI bytes sent, %u saved\n",
+      stats.frames, stats.fullFlushes, stats.rowsSent, stats.noops, stats.bytesSent, stats.bytesSaved);
+  }
+}
+
+//collects what has arrived so far without waiting for the rest of the line,
+//a command runs once its newline is in. Longer lines are cut
+static void handleSerialCommands()
+{
+  static char line[128];
+  static size_t length = 0;
+
+  while (Serial.available())
+  {
+    char c = Serial.read();
+    if (c != '\n')
+    {
+      if (length < sizeof(line) - 1)
+        line[length++] = c;
+      continue;
+    }
+    line[length] = '\0';
+    length = 0;
+    runSerialCommand(line);
+  }
+}
+
+//how often loop() looks at the serial console
+static const uint32_t SERIAL_POLL_MS = 100;
+
 void setup() {
+  Metrics::getInstance().addTask(xTaskGetCurrentTaskHandle(), getArduinoLoopTaskStackSize());
   hardware_init();
   create_tasks();
+  FrameMirror::begin(Serial);
 
-  //NTP client
-  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-
-  ResourceManager<LMDS>::getInstance().initialize(new LMDS(8, 5)); // 8 modules, CS pin 5
+  //the display comes first, nothing below blocks on the network
+  LMDS* display = new LMDS(8, 5); // 8 modules, CS pin 5
+  display->begin();
+  //rows go out by DMA while the next frame is drawn
+  display->beginAsyncFlush();
+  ResourceManager<LMDS>::getInstance().initialize(display);
 
   dataStore.load_from_file("/config.txt");
+  dataStore.startWriteBack();
+  stripCacheBytesKey = dataStore.key("strip_cache_bytes");
+  configChanged = dataStore.subscribe({stripCacheBytesKey});
+  applyConfig();
 
   //xTaskCreate(animateDisplay, "DisplayTask", 2048, nullptr, 1, nullptr);
-  xTaskCreate(displayClock, "ClockTask", 2048, nullptr, 1, nullptr);
+  Compositor::getInstance().begin();
+  publishClock();
+  //the last known content until the sources have fetched theirs
+  ContentCache::getInstance().restore();
   //xTaskCreate(marqueeDisplay, "MarqueeTask", 2048, nullptr, 1, nullptr);
-  //xTaskCreate(open_weather_map_task, "WeatherTask", 8192, nullptr, 1, nullptr);
-  xTaskCreate(lhc_status_task, "LHCStatusTask", 8192, nullptr, 1, nullptr);
 
-  
+  //all content is fetched one source at a time by the scheduler, once WiFi is up
+  //register_weather_source();
+  register_lhc_status_source();
+  BootProgress::getInstance().begin([]() { FetchScheduler::getInstance().begin(EVENT_LOOP_MODE); });
 }
 
 void loop() 
 {
+  static uint32_t lastSample = 0;
+  if (millis() - lastSample >= Metrics::SAMPLE_PERIOD_MS)
+  {
+    lastSample = millis();
+    Metrics::getInstance().sample();
+  }
+  handleSerialCommands();
+  if (dataStore.wait_for_change(configChanged, 0))
+    applyConfig();
+  uint32_t wait = std::min(SERIAL_POLL_MS, BootProgress::getInstance().poll());
+
+#if EVENT_LOOP_MODE
+  wait = std::min(wait, FetchScheduler::getInstance().poll());
+  wait = std::min(wait, blink_led_poll());
+#endif
+
+  //sleeps until the next step is due, the scheduler wakes it early when a source is added or triggered
+  if (wait > 0)
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
 }
@@ -0,0 +1,99 @@
+#include <metrics.hpp>
+#include <string.h>
+#include <algorithm>
+
+Metrics::Metrics()
+{
+    mutex = xSemaphoreCreateMutex();
+}
+
+void Metrics::addTask(TaskHandle_t task, uint32_t stackSize)
+{
+    if (task == nullptr)
+        return;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (taskCount < MAX_TASKS)
+        tasks[taskCount++] = TaskInfo{task, stackSize, uxTaskGetStackHighWaterMark(task)};
+    xSemaphoreGive(mutex);
+}
+
+void Metrics::recordDuration(const char* name, uint32_t us)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Series* entry = nullptr;
+    for (size_t i = 0; i < seriesCount && entry == nullptr; i++)
+        if (strcmp(series[i].name, name) == 0)
+            entry = &series[i];
+
+    if (entry == nullptr && seriesCount < MAX_SERIES)
+    {
+        entry = &series[seriesCount++];
+        memset(entry, 0, sizeof(Series));
+        strncpy(entry->name, name, sizeof(entry->name) - 1);
+        entry->minUs = UINT32_MAX;
+    }
+
+    if (entry)
+    {
+        entry->recent[entry->count % SERIES_SAMPLES] = us;
+        entry->count++;
+        entry->minUs = std::min(entry->minUs, us);
+        entry->maxUs = std::max(entry->maxUs, us);
+        entry->totalUs += us;
+    }
+    xSemaphoreGive(mutex);
+}
+
+void Metrics::sample()
+{
+    HeapSample sample{millis(), ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap()};
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    heap[heapNext] = sample;
+    heapNext = (heapNext + 1) % HEAP_SAMPLES;
+    heapCount = std::min(heapCount + 1, HEAP_SAMPLES);
+
+    for (size_t i = 0; i < taskCount; i++)
+        tasks[i].minFreeStack = uxTaskGetStackHighWaterMark(tasks[i].handle);
+    xSemaphoreGive(mutex);
+}
+
+void Metrics::dump(Print& out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    out.printf("#metrics begin,uptime_ms=%u\n", (unsigned)millis());
+
+    out.println("#heap,time_ms,free,min_free,largest_block,fragmentation_pct");
+    for (size_t i = 0; i < heapCount; i++)
+    {
+        const HeapSample& s = heap[(heapNext + HEAP_SAMPLES - heapCount + i) % HEAP_SAMPLES];
+        unsigned fragmentation = s.freeHeap ? 100 - (uint64_t)s.largestBlock * 100 / s.freeHeap : 0;
+        out.printf("heap,%u,%u,%u,%u,%u\n", s.timeMs, s.freeHeap, s.minFreeHeap, s.largestBlock, fragmentation);
+    }
+
+    out.println("#task,name,stack_size,min_free_stack,max_used");
+    for (size_t i = 0; i < taskCount; i++)
+    {
+        const TaskInfo& t = tasks[i];
+        out.printf("task,%s,%u,%u,%u\n", pcTaskGetName(t.handle), t.stackSize, t.minFreeStack,
+            t.stackSize > t.minFreeStack ? t.stackSize - t.minFreeStack : 0);
+    }
+
+    out.println("#duration,name,count,min_us,avg_us,max_us,recent_us...");
+    for (size_t i = 0; i < seriesCount; i++)
+    {
+        const Series& s = series[i];
+        out.printf("duration,%s,%u,%u,%u,%u", s.name, s.count, s.count ? s.minUs : 0,
+            s.count ? (unsigned)(s.totalUs / s.count) : 0, s.maxUs);
+
+        //oldest first
+        size_t recent = std::min<size_t>(s.count, SERIES_SAMPLES);
+        for (size_t j = 0; j < recent; j++)
+            out.printf(",%u", s.recent[(s.count - recent + j) % SERIES_SAMPLES]);
+        out.println();
+    }
+
+    out.println("#metrics end");
+    xSemaphoreGive(mutex);
+}
@@ -0,0 +1,121 @@
+#include <strip_cache.hpp>
+
+// Adafruit_GFX target that writes straight into column bytes,
+// it is only used to rasterize a message once when it enters the cache
+class StripRenderer : public Adafruit_GFX
+{
+public:
+    StripRenderer(std::vector<uint8_t>& columns) : Adafruit_GFX(0x7FFF, 8), columns(columns)
+    {
+        setTextWrap(false);
+        setTextColor(1);
+    }
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override
+    {
+        if (x < 0 || x >= (int16_t)columns.size() || y < 0 || y >= 8)
+            return;
+
+        if (color)
+            columns[x] |= 1 << y;
+        else
+            columns[x] &= ~(1 << y);
+    }
+
+private:
+    std::vector<uint8_t>& columns;
+};
+
+static std::shared_ptr<const MessageStrip> renderStrip(const std::string& text, const GFXfont* font)
+{
+    auto strip = std::make_shared<MessageStrip>();
+    StripRenderer renderer(strip->columns);
+
+    if (font == nullptr)
+    {
+        //built-in font: 5 pixels + 1 pixel space, top of the glyph at the cursor
+        strip->columns.assign(text.size() * 6, 0);
+        renderer.setCursor(0, 0);
+    }
+    else
+    {
+        //custom fonts are drawn from the baseline, move the bounding box to (0, 0)
+        int16_t x1, y1;
+        uint16_t w, h;
+        renderer.setFont(font);
+        renderer.getTextBounds(text.c_str(), 0, 0, &x1, &y1, &w, &h);
+        strip->columns.assign(w, 0);
+        renderer.setCursor(-x1, -y1);
+    }
+
+    renderer.print(text.c_str());
+    return strip;
+}
+
+StripCache::StripCache()
+{
+    mutex = xSemaphoreCreateMutex();
+}
+
+std::shared_ptr<const MessageStrip> StripCache::get(const std::string& text, const GFXfont* font)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->font == font && it->text == text)
+        {
+            stats.hits++;
+            entries.splice(entries.begin(), entries, it);
+            auto strip = it->strip;
+            xSemaphoreGive(mutex);
+            return strip;
+        }
+    }
+
+    stats.misses++;
+    entries.push_front(Entry{text, font, renderStrip(text, font)});
+    stats.bytes += entries.front().bytes();
+    stats.entries = entries.size();
+    evict();
+
+    auto strip = entries.front().strip;
+    xSemaphoreGive(mutex);
+    return strip;
+}
+
+void StripCache::evict()
+{
+    while (stats.bytes > budget && entries.size() > 1)
+    {
+        stats.bytes -= entries.back().bytes();
+        stats.evictions++;
+        entries.pop_back();
+    }
+    stats.entries = entries.size();
+}
+
+void StripCache::setBudget(size_t bytes)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    budget = bytes;
+    evict();
+    xSemaphoreGive(mutex);
+}
+
+StripCache::Stats StripCache::getStats()
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    Stats s = stats;
+    xSemaphoreGive(mutex);
+    return s;
+}
+
+void StripCache::clear()
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    entries.clear();
+    stats.bytes = 0;
+    stats.entries = 0;
+    xSemaphoreGive(mutex);
+}
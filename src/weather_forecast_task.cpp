@@ -1,16 +1,16 @@
 
 #include <string>
-#include <vector>
 #include <cstdint>
-#include <map>
-#include <set>
-
-#include <AJSP.hpp>
-#include <MapCollector.hpp>
+#include <cstdlib>
 
 #include <data_store.hpp>
 #include <http_utils.hpp>
-#include <graphic_utils.hpp>
+#include <json_path_matcher.hpp>
+#include <compositor.hpp>
+#include <content_cache.hpp>
+#include <fetch_scheduler.hpp>
+#include <metrics.hpp>
+#include <esp_timer.h>
 #include <pgmspace.h>
 #include <resource_manager.hpp>
 #include <LMDS.hpp>
@@ -19,64 +19,125 @@
 static const char OW_WEATHER_API_CURRENT[]  PROGMEM = "http://api.openweathermap.org/data/2.5/weather?id=%s&appid=%s&units=metric";
 static const char OW_WEATHER_API_FORECAST[] PROGMEM = "http://api.openweathermap.org/data/2.5/forecast?id=%s&appid=%s&units=metric";
 
-std::map<std::string, std::string> parseJsonWithPredicate(const String &json, const std::set<std::string> &keys)
+// /main/temp
+static constexpr JsonPathNode weatherPaths[] = {
+    { -1, "main", 0, -1 },
+    {  0, "temp", 0, 0 },
+};
+enum WeatherSlot { CURRENT_TEMP };
+
+// /list/2/main/temp, /list/2/weather/0/description, /city/name
+static constexpr JsonPathNode forecastPaths[] = {
+    { -1, "list", 0, -1 },
+    {  0, nullptr, 2, -1 },
+    {  1, "main", 0, -1 },
+    {  2, "temp", 0, 0 },
+    {  1, "weather", 0, -1 },
+    {  4, nullptr, 0, -1 },
+    {  5, "description", 0, 1 },
+    { -1, "city", 0, -1 },
+    {  7, "name", 0, 2 },
+};
+enum ForecastSlot { FORECAST_TEMP, FORECAST_DESCRIPTION, CITY_NAME };
+
+typedef JsonPathMatcher<JsonPath::slotCount(weatherPaths)> WeatherMatcher;
+typedef JsonPathMatcher<JsonPath::slotCount(forecastPaths)> ForecastMatcher;
+
+// Feeds the body straight from the socket into the matcher, nothing is buffered.
+// Once all values are in, the rest of the body is only drained
+template <typename Matcher>
+class JsonPathSink : public HttpUtils::HttpSink
 {
-    // predicate used by MapCollector to decide which keys to keep, ignore values
-    auto keep_pred = [&keys](const std::string& path, const std::string& value) -> bool {
-        return keys.find(std::string(path)) != keys.end();
-    };
-
-    MapCollector mc(keep_pred);   
-    for (auto ch : json) {
-        // missing error handling here
-        mc.parse(ch);
+public:
+    JsonPathSink(Matcher& matcher) : matcher(matcher) {}
+
+    bool onData(const uint8_t* data, size_t len) override
+    {
+        int64_t start = esp_timer_get_time();
+        matcher.feed(data, len);
+        parseTimeUs += esp_timer_get_time() - start;
+        return true;
     }
 
-    return mc.getValues(); 
-}
+    bool satisfied() const override
+    {
+        return matcher.done();
+    }
 
-static const std::set<std::string> weatherKeys = {
-    "/root/main/temp"
-};
+    uint32_t parseTimeUs = 0;   // spent in the matcher, without the network
 
-static const std::set<std::string> forecastKeys = {
-    "/root/list/2/main/temp",
-    "/root/list/2/weather/0/description",
-    "/root/city/name"
+private:
+    Matcher& matcher;
 };
 
+// result is only replaced by a complete 200 response, a 304 leaves the one of the last fetch in place
+template <typename Matcher, size_t N>
+int fetchJsonPaths(const String &url, const JsonPathNode (&paths)[N], Matcher& result, const char* series)
+{
+    Matcher matcher(paths);
+    JsonPathSink<Matcher> sink(matcher);
+    int response = HttpUtils::httpGetStream(url, sink, false, nullptr, 0, result.complete());
+
+    if (response == HTTP_CODE_OK)
+    {
+        Metrics::getInstance().recordDuration(series, sink.parseTimeUs);
+        //a body without all the values is as good as no answer
+        if (not matcher.complete())
+            return HttpUtils::HTTP_ERROR_INCOMPLETE_BODY;
+        result = matcher;
+    }
+    return response;
+}
+
 std::string readWeatherFromOWM()
 {
-    auto apiKey = DataStore::getInstance().get_value("ow_api_key", "");
-    auto cityId = DataStore::getInstance().get_value("ow_city_id", "");
+    auto& store = DataStore::getInstance();
+    static const DataStore::Key apiKeyHandle = store.key("ow_api_key");
+    static const DataStore::Key cityIdHandle = store.key("ow_city_id");
+    char apiKey[48];
+    char cityId[16];
+    //a cut key or city id would only fetch the wrong thing, or be rejected after a round trip
+    if (store.copy_value(apiKeyHandle, apiKey, sizeof(apiKey)) >= sizeof(apiKey) ||
+        store.copy_value(cityIdHandle, cityId, sizeof(cityId)) >= sizeof(cityId))
+    {
+        Serial.printf("Weather: ow_api_key or ow_city_id too long (max %u and %u characters)\n",
+            unsigned(sizeof(apiKey) - 1), unsigned(sizeof(cityId) - 1));
+        return std::string();
+    }
 
     //read current weather
     char url[128];
-    snprintf(url, sizeof(url), OW_WEATHER_API_CURRENT, cityId.c_str(), apiKey.c_str());
+    int length = snprintf(url, sizeof(url), OW_WEATHER_API_CURRENT, cityId, apiKey);
+    if (length < 0 || size_t(length) >= sizeof(url))
+    {
+        Serial.printf("Weather: current weather URL too long (%d characters)\n", length);
+        return std::string();
+    }
 
-    String output;
-    auto response = HttpUtils::httpGet(url, output, false);
-    if (response != 200)
+    //kept between calls, a 304 reuses the values of the last fetch
+    static WeatherMatcher currentWeather(weatherPaths);
+    auto response = fetchJsonPaths(url, weatherPaths, currentWeather, "parse.weather");
+    if (response != 200 && response != HTTP_CODE_NOT_MODIFIED)
     {
         Serial.printf("HTTP GET failed, response: %d\n", response);
-        vTaskDelay(60000 / portTICK_PERIOD_MS); // wait a minute before retrying
         return std::string();
     }
-
-    auto currentWeather = parseJsonWithPredicate(output, weatherKeys);
     
     //read forcast
-    snprintf(url, sizeof(url), OW_WEATHER_API_FORECAST, cityId.c_str(), apiKey.c_str());
-    response = HttpUtils::httpGet(url, output, false);
-    if (response != 200)
+    length = snprintf(url, sizeof(url), OW_WEATHER_API_FORECAST, cityId, apiKey);
+    if (length < 0 || size_t(length) >= sizeof(url))
+    {
+        Serial.printf("Weather: forecast URL too long (%d characters)\n", length);
+        return std::string();
+    }
+    static ForecastMatcher foracastWeather(forecastPaths);
+    response = fetchJsonPaths(url, forecastPaths, foracastWeather, "parse.forecast");
+    if (response != 200 && response != HTTP_CODE_NOT_MODIFIED)
     {
         Serial.printf("HTTP GET failed, response: %d\n", response);
-        vTaskDelay(60000 / portTICK_PERIOD_MS); // wait a minute before retrying
         return std::string();
     }
 
-    auto foracastWeather = parseJsonWithPredicate(output, forecastKeys);
-
     //create result string witht he following format:
     // Name: temp ^C (forecast temperature ^C, forecast description))
 
@@ -85,54 +146,42 @@ std::string readWeatherFromOWM()
 
     char weatherInfo[256];
     snprintf_P(weatherInfo, sizeof(weatherInfo), WEATHER_FMT,
-        foracastWeather["/root/city/name"].c_str(),
-        std::stof(currentWeather["/root/main/temp"]),
-        std::stof(foracastWeather["/root/list/2/main/temp"]),
-        foracastWeather["/root/list/2/weather/0/description"].c_str()
+        foracastWeather.value(CITY_NAME),
+        strtof(currentWeather.value(CURRENT_TEMP), nullptr),
+        strtof(foracastWeather.value(FORECAST_TEMP), nullptr),
+        foracastWeather.value(FORECAST_DESCRIPTION)
     );
 
     return weatherInfo;
 }
 
-void open_weather_map_task(void *parameter)
+static bool fetchWeather()
 {
-    std::string messageToBeDisplayed;
-    time_t last_weather_update = 0;
-
-    auto& rmd = ResourceManager<LMDS>::getInstance();
-    auto& matrix = rmd.getResourceRef();
+    auto newWeather = readWeatherFromOWM();
+    if (newWeather.empty())
+        return false;
+
+    Serial.printf("Weather: %s\n", newWeather.c_str());
+
+    //the compositor keeps showing it every 20 s until the next update
+    ContentItem item;
+    item.id = "weather";
+    item.text = newWeather;
+    item.intervalMs = 20000;
+    item.priority = ResourceManager<LMDS>::PRIORITY_LOW;
+    ContentCache::getInstance().publish(item);
+    return true;
+}
 
-    while (true)
-    {
-        if (difftime(time(nullptr), last_weather_update) > 900)
-        {
-            auto newWeather = readWeatherFromOWM();
-            if (not newWeather.empty())
-            {
-                messageToBeDisplayed = newWeather;
-                last_weather_update = time(nullptr);
-            }               
-        }
-
-        if (messageToBeDisplayed.empty())
-        {
-            vTaskDelay(60000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
-        Serial.printf("Weather: %s\n", messageToBeDisplayed.c_str());
-
-        if (not rmd.make_access_request())
-        {
-            Serial.println("WeatherDisplay: Failed to get access to display");
-            vTaskDelay(60000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
-
-        scrollMessage(messageToBeDisplayed, matrix, 50);
-        rmd.release_access();
-
-        vTaskDelay(20000 / portTICK_PERIOD_MS); // update every minute
-    }
-}
\ No newline at end of file
+void register_weather_source()
+{
+    FetchSource source;
+    source.name = "weather";
+    source.fetch = fetchWeather;
+    source.intervalMs = 900000; // update every 15 minutes
+    source.jitterMs = 60000;
+    source.retryMs = 60000;
+    source.maxBackoffMs = 900000;
+    source.heapNeeded = 48 * 1024;  // gzip window, plain HTTP
+    FetchScheduler::getInstance().add(source);
+}
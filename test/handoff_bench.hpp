@@ -0,0 +1,100 @@
+// Hand-off latency of ResourceManager, shared by test_handoff_task and test_handoff_direct: each
+// suite selects its backend with RESOURCE_MANAGER_DIRECT_HANDOFF and includes this file.
+// Tasks run as threads on the FreeRTOS mocks, so the numbers compare the backends on the host,
+// not the board.
+#include <unity.h>
+#include <resource_manager.hpp>
+#include <native_runtime.hpp>
+
+#include <atomic>
+
+static const int WORKERS = 3;
+static const int ROUNDS = 2000;
+static const int64_t HOLD_US = 20;
+
+struct Matrix
+{
+};
+
+static Matrix matrix;
+// never destroyed, the manager task of the task backend outlives the tests
+static ResourceManager<Matrix>& manager = *new ResourceManager<Matrix>();
+static TaskHandle_t mainTask;
+static std::atomic<int> holders(0);
+static std::atomic<int> overlaps(0);
+
+static void worker_task_function(void*)
+{
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        manager.make_access_request(ResourceManager<Matrix>::PRIORITY_NORMAL);
+        if (holders.fetch_add(1) != 0)
+            overlaps++;
+        int64_t until = esp_timer_get_time() + HOLD_US;
+        while (esp_timer_get_time() < until)
+        {
+        }
+        holders.fetch_sub(1);
+        manager.release_access();
+    }
+    xTaskNotifyGive(mainTask);
+    while (true)
+        vTaskDelay(1000);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_handoff_latency()
+{
+    mainTask = xTaskGetCurrentTaskHandle();
+    manager.initialize(&matrix);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < WORKERS; i++)
+        xTaskCreate(worker_task_function, "Worker", 2048, nullptr, 1, nullptr);
+    for (int done = 0; done < WORKERS;)
+        done += ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    uint32_t grants = 0;
+    ResourceManager<Matrix>::RequesterStats requester;
+    for (size_t i = 0; manager.get_requester_stats(i, requester); i++)
+    {
+        grants += requester.grants;
+        TEST_ASSERT_EQUAL(0, requester.denials);
+    }
+    TEST_ASSERT_EQUAL(WORKERS * ROUNDS, grants);
+    TEST_ASSERT_EQUAL_MESSAGE(0, overlaps.load(), "two holders at once");
+
+    ResourceManager<Matrix>::HandoffStats handoff = manager.get_handoff_stats();
+    TEST_ASSERT_TRUE(handoff.count > 0);
+
+    //median from the power of two histogram: the upper edge of the bucket holding it
+    uint32_t seen = 0;
+    uint32_t median = 0;
+    for (uint8_t b = 0; b < ResourceManager<Matrix>::HISTOGRAM_BUCKETS; b++)
+    {
+        seen += handoff.histogram[b];
+        if (seen * 2 >= handoff.count)
+        {
+            median = 1u << b;
+            break;
+        }
+    }
+
+    char message[200];
+    snprintf(message, sizeof(message),
+        "backend=%s handoffs=%u avg=%u us median<%u us max=%u us, %.1f us per grant with %d us holds",
+        RESOURCE_MANAGER_DIRECT_HANDOFF ? "direct" : "task", handoff.count,
+        uint32_t(handoff.total_us / handoff.count), median, handoff.max_us,
+        double(elapsed) / grants, int(HOLD_US));
+    TEST_MESSAGE(message);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_handoff_latency);
+    return UNITY_END();
+}
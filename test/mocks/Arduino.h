@@ -0,0 +1,103 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core the headers under test use.
+// Serial keeps everything written to it in `output`, so tests can check the log.
+// Pin writes go to `busLog`, where the SPI mock logs its traffic too, so tests see both in order.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+// the SPI pins of the ESP32-C3 variant
+static const uint8_t MOSI = 6;
+static const uint8_t SCK = 4;
+
+struct MockBusEvent
+{
+    enum Kind : uint8_t { PinWrite, BeginTransaction, Transfer, EndTransaction, QueueTransaction };
+
+    Kind kind;
+    uint8_t pin;        // PinWrite
+    uint16_t value;     // the level of a PinWrite, the word of a Transfer, the words of a queued transaction
+};
+
+extern std::vector<MockBusEvent> busLog;
+
+// only declared, for the signatures that take one
+class String;
+
+inline void pinMode(uint8_t, uint8_t) {}
+
+inline void digitalWrite(uint8_t pin, uint8_t level)
+{
+    busLog.push_back({MockBusEvent::PinWrite, pin, level});
+}
+
+inline uint32_t millis()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t* data, size_t len)
+    {
+        size_t written = 0;
+        while (written < len && write(data[written]))
+            written++;
+        return written;
+    }
+
+    size_t print(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+    size_t print(char c) { return write(uint8_t(c)); }
+    size_t println(const char* text) { return print(text) + println(); }
+    size_t println() { return print('\n'); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return length > 0 ? write(reinterpret_cast<const uint8_t*>(buffer), std::min<size_t>(length, sizeof(buffer) - 1)) : 0;
+    }
+};
+
+class MockSerial : public Print
+{
+public:
+    using Print::write;
+
+    size_t write(uint8_t c) override
+    {
+        output += char(c);
+        return 1;
+    }
+
+    std::string output;
+};
+
+extern MockSerial Serial;
+
+#endif // MOCK_ARDUINO_H
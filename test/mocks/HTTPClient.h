@@ -0,0 +1,30 @@
+#ifndef MOCK_HTTP_CLIENT_H
+#define MOCK_HTTP_CLIENT_H
+
+// Host stand-in for the status codes of the Arduino HTTPClient, enough to include http_utils.hpp.
+// Nothing can be sent, HTTPClient is only declared.
+
+#include <Arduino.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+enum t_http_codes
+{
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_NOT_MODIFIED = 304,
+    HTTP_CODE_NOT_FOUND = 404,
+};
+
+class HTTPClient;
+
+#endif // MOCK_HTTP_CLIENT_H
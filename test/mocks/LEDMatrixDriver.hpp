@@ -0,0 +1,74 @@
+#ifndef MOCK_LED_MATRIX_DRIVER_HPP
+#define MOCK_LED_MATRIX_DRIVER_HPP
+
+// Host stand-in for LEDMatrixDriver without Adafruit_GFX: the packed frame buffer with the
+// library's layout (8 rows of one byte per module, MSB is the leftmost pixel) and the calls LMDS
+// makes. display() sends the whole buffer through the SPI mock the way the library does.
+
+#include <Arduino.h>
+#include <SPI.h>
+
+class LEDMatrixDriver
+{
+public:
+    LEDMatrixDriver(uint8_t N, uint8_t ssPin, uint8_t flags = 0, uint8_t* frameBuffer = nullptr)
+        : N(N), ssPin(ssPin), frameBuffer(frameBuffer ? frameBuffer : new uint8_t[N * 8]()),
+          ownsBuffer(frameBuffer == nullptr)
+    {
+        (void)flags;
+    }
+
+    virtual ~LEDMatrixDriver()
+    {
+        if (ownsBuffer)
+            delete[] frameBuffer;
+    }
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    void setIntensity(uint8_t level) { intensity = level; }
+
+    void setPixel(int16_t x, int16_t y, bool enabled)
+    {
+        if (x < 0 || y < 0 || x >= N * 8 || y >= 8)
+            return;
+        uint8_t bit = 0x80 >> (x & 7);
+        uint8_t& byte = frameBuffer[y * N + x / 8];
+        byte = enabled ? byte | bit : byte & ~bit;
+    }
+
+    bool getPixel(int16_t x, int16_t y) const
+    {
+        if (x < 0 || y < 0 || x >= N * 8 || y >= 8)
+            return false;
+        return frameBuffer[y * N + x / 8] & (0x80 >> (x & 7));
+    }
+
+    void clear() { memset(frameBuffer, 0, N * 8); }
+
+    void display()
+    {
+        for (uint8_t row = 0; row < 8; row++)
+        {
+            digitalWrite(ssPin, LOW);
+            SPI.beginTransaction(SPISettings(5000000, MSBFIRST, SPI_MODE0));
+            for (uint8_t module = 0; module < N; module++)
+                SPI.transfer16(uint16_t(row + 1) << 8 | frameBuffer[row * N + module]);
+            digitalWrite(ssPin, HIGH);
+            SPI.endTransaction();
+        }
+    }
+
+    uint8_t* getFrameBuffer() const { return frameBuffer; }
+    uint8_t getSegments() const { return N; }
+
+    bool enabled = false;
+    uint8_t intensity = 0;
+
+private:
+    const uint8_t N;
+    const uint8_t ssPin;
+    uint8_t* frameBuffer;
+    const bool ownsBuffer;
+};
+
+#endif // MOCK_LED_MATRIX_DRIVER_HPP
@@ -0,0 +1,97 @@
+#ifndef MOCK_LITTLEFS_H
+#define MOCK_LITTLEFS_H
+
+// In-memory file system in place of LittleFS, tests put files in and read them back through `files`
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+class File : public Print
+{
+public:
+    File() = default;
+    File(std::shared_ptr<std::string> data, bool writable) : data(data), writable(writable) {}
+
+    using Print::write;
+
+    explicit operator bool() const { return data != nullptr; }
+
+    size_t size() const { return data ? data->size() : 0; }
+    size_t position() const { return pos; }
+    int available() const { return data ? int(data->size() - pos) : 0; }
+
+    size_t write(uint8_t c) override
+    {
+        if (not data || not writable)
+            return 0;
+        data->push_back(char(c));
+        return 1;
+    }
+
+    size_t read(uint8_t* buffer, size_t len)
+    {
+        size_t count = std::min(len, size_t(available()));
+        if (count)
+            memcpy(buffer, data->data() + pos, count);
+        pos += count;
+        return count;
+    }
+
+    int read()
+    {
+        return available() > 0 ? uint8_t((*data)[pos++]) : -1;
+    }
+
+    void close()
+    {
+        data.reset();
+        pos = 0;
+    }
+
+private:
+    std::shared_ptr<std::string> data;
+    size_t pos = 0;
+    bool writable = false;
+};
+
+class MockFS
+{
+public:
+    bool begin(bool = false) { return true; }
+    void end() {}
+
+    // "r" opens an existing file, "w" creates or truncates it
+    File open(const char* path, const char* mode = "r")
+    {
+        if (mode[0] == 'w')
+        {
+            auto& data = files[path];
+            data = std::make_shared<std::string>();
+            return File(data, true);
+        }
+        auto it = files.find(path);
+        return it == files.end() ? File() : File(it->second, false);
+    }
+
+    bool exists(const char* path) const { return files.count(path) != 0; }
+    bool remove(const char* path) { return files.erase(path) != 0; }
+
+    bool rename(const char* from, const char* to)
+    {
+        auto it = files.find(from);
+        if (it == files.end())
+            return false;
+        files[to] = it->second;
+        files.erase(from);
+        return true;
+    }
+
+    std::map<std::string, std::shared_ptr<std::string>> files;
+};
+
+extern MockFS LittleFS;
+
+#endif // MOCK_LITTLEFS_H
@@ -0,0 +1,48 @@
+#ifndef MOCK_SPI_H
+#define MOCK_SPI_H
+
+// Host stand-in for the Arduino SPI class: nothing is clocked out, transactions and words are
+// appended to busLog (see Arduino.h) next to the pin writes that frame them.
+
+#include <Arduino.h>
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+struct SPISettings
+{
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass
+{
+public:
+    void begin() {}
+    void end() {}
+
+    void beginTransaction(const SPISettings&)
+    {
+        busLog.push_back({MockBusEvent::BeginTransaction, 0, 0});
+    }
+
+    void endTransaction()
+    {
+        busLog.push_back({MockBusEvent::EndTransaction, 0, 0});
+    }
+
+    uint16_t transfer16(uint16_t word)
+    {
+        busLog.push_back({MockBusEvent::Transfer, 0, word});
+        return 0;
+    }
+};
+
+extern SPIClass SPI;
+
+#endif // MOCK_SPI_H
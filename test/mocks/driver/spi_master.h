@@ -0,0 +1,187 @@
+#ifndef MOCK_SPI_MASTER_H
+#define MOCK_SPI_MASTER_H
+
+// Host stand-in for the ESP-IDF spi_master driver, one bus with one device. A queued transaction
+// is logged to busLog (see Arduino.h) as a QueueTransaction; when it is clocked out its words show
+// up there as Transfers between the CS pin going low and high, then post_cb runs as the interrupt
+// would and the transaction is handed back by spi_device_get_trans_result().
+// Transactions are clocked out as they are queued, unless mockSpiBus.clockOnQueue is false: then
+// they wait for mockSpiClockOut(), which the suites call from another thread than the renderer's.
+
+#include <Arduino.h>
+
+#include <deque>
+#include <mutex>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT 0x107
+
+enum spi_host_device_t { SPI1_HOST, SPI2_HOST };
+#define SPI_DMA_CH_AUTO 3
+
+struct spi_bus_config_t
+{
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+    int intr_flags;
+};
+
+struct spi_transaction_t
+{
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length;      // in bits
+    size_t rxlength;
+    void* user;
+    const void* tx_buffer;
+    void* rx_buffer;
+};
+
+typedef void (*transaction_cb_t)(spi_transaction_t* transaction);
+
+struct spi_device_interface_config_t
+{
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    uint16_t duty_cycle_pos;
+    uint16_t cs_ena_pretrans;
+    uint8_t cs_ena_posttrans;
+    int clock_speed_hz;
+    int input_delay_ns;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    transaction_cb_t pre_cb;
+    transaction_cb_t post_cb;
+};
+
+struct spi_device_t
+{
+    spi_device_interface_config_t config;
+    std::deque<spi_transaction_t*> queued;      // not clocked out yet
+    std::deque<spi_transaction_t*> done;        // for spi_device_get_trans_result()
+};
+typedef spi_device_t* spi_device_handle_t;
+
+struct MockSpiBus
+{
+    std::recursive_mutex mutex;
+    bool initialized = false;
+    spi_bus_config_t config;
+    spi_device_handle_t device = nullptr;
+    bool clockOnQueue = true;
+};
+
+inline MockSpiBus& mockSpiBus()
+{
+    static MockSpiBus bus;
+    return bus;
+}
+
+// clocks out every queued transaction, returns how many
+inline size_t mockSpiClockOut()
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    spi_device_handle_t device = bus.device;
+    size_t count = 0;
+    while (device && not device->queued.empty())
+    {
+        spi_transaction_t* transaction = device->queued.front();
+        device->queued.pop_front();
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(transaction->tx_buffer);
+        busLog.push_back({MockBusEvent::PinWrite, uint8_t(device->config.spics_io_num), LOW});
+        for (size_t i = 0; i + 1 < transaction->length / 8; i += 2)
+            busLog.push_back({MockBusEvent::Transfer, 0, uint16_t(bytes[i] << 8 | bytes[i + 1])});
+        busLog.push_back({MockBusEvent::PinWrite, uint8_t(device->config.spics_io_num), HIGH});
+
+        device->done.push_back(transaction);
+        if (device->config.post_cb)
+            device->config.post_cb(transaction);
+        count++;
+    }
+    return count;
+}
+
+inline esp_err_t spi_bus_initialize(spi_host_device_t, const spi_bus_config_t* config, int)
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    if (bus.initialized)
+        return ESP_ERR_INVALID_STATE;
+    bus.initialized = true;
+    bus.config = *config;
+    return ESP_OK;
+}
+
+inline esp_err_t spi_bus_free(spi_host_device_t)
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    if (not bus.initialized || bus.device)
+        return ESP_ERR_INVALID_STATE;
+    bus.initialized = false;
+    return ESP_OK;
+}
+
+inline esp_err_t spi_bus_add_device(spi_host_device_t, const spi_device_interface_config_t* config, spi_device_handle_t* handle)
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    if (not bus.initialized || bus.device)
+        return ESP_ERR_INVALID_STATE;
+    bus.device = new spi_device_t();
+    bus.device->config = *config;
+    *handle = bus.device;
+    return ESP_OK;
+}
+
+inline esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    if (handle != bus.device || not handle->queued.empty() || not handle->done.empty())
+        return ESP_ERR_INVALID_STATE;
+    delete handle;
+    bus.device = nullptr;
+    return ESP_OK;
+}
+
+// a full queue fails right away instead of blocking
+inline esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* transaction, TickType_t)
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    if (handle->queued.size() + handle->done.size() >= size_t(handle->config.queue_size))
+        return ESP_ERR_TIMEOUT;
+    handle->queued.push_back(transaction);
+    busLog.push_back({MockBusEvent::QueueTransaction, 0, uint16_t(transaction->length / 16)});
+    if (bus.clockOnQueue)
+        mockSpiClockOut();
+    return ESP_OK;
+}
+
+// does not wait, a transaction that is not out yet is a timeout
+inline esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** transaction, TickType_t)
+{
+    MockSpiBus& bus = mockSpiBus();
+    std::lock_guard<std::recursive_mutex> lock(bus.mutex);
+    if (handle->done.empty())
+        return ESP_ERR_TIMEOUT;
+    *transaction = handle->done.front();
+    handle->done.pop_front();
+    return ESP_OK;
+}
+
+#endif // MOCK_SPI_MASTER_H
@@ -0,0 +1,22 @@
+#ifndef MOCK_ESP_HEAP_CAPS_H
+#define MOCK_ESP_HEAP_CAPS_H
+
+// Host stand-in for the ESP-IDF capability allocator, every kind of memory is the plain heap
+
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_8BIT (1 << 2)
+
+inline void* heap_caps_malloc(size_t size, uint32_t)
+{
+    return malloc(size);
+}
+
+inline void heap_caps_free(void* memory)
+{
+    free(memory);
+}
+
+#endif // MOCK_ESP_HEAP_CAPS_H
@@ -0,0 +1,283 @@
+#ifndef MOCK_FREERTOS_H
+#define MOCK_FREERTOS_H
+
+// Host stand-in for the FreeRTOS calls of the headers under test. A tick is a millisecond.
+// Tasks run as detached threads (priorities are ignored), task notifications and queues block
+// like the real ones, mutexes are real. Event groups do not block.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef std::recursive_timed_mutex* SemaphoreHandle_t;
+
+struct MockTask
+{
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable wake;
+    uint32_t value = 0;
+    bool pending = false;
+};
+typedef MockTask* TaskHandle_t;
+
+struct MockEventGroup
+{
+    EventBits_t bits = 0;
+};
+typedef MockEventGroup* EventGroupHandle_t;
+
+struct portMUX_TYPE
+{
+    std::recursive_mutex mutex;
+};
+
+enum eNotifyAction { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite, eSetValueWithoutOverwrite };
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY TickType_t(0xFFFFFFFF)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) TickType_t(ms)
+#define tskIDLE_PRIORITY 0
+
+#define portMUX_INITIALIZE(mux) ((void)(mux))
+#define taskENTER_CRITICAL(mux) ((mux)->mutex.lock())
+#define taskEXIT_CRITICAL(mux) ((mux)->mutex.unlock())
+#define taskENTER_CRITICAL_ISR(mux) taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux) taskEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+// waits on `condition` with the task's lock held, forever for portMAX_DELAY
+template <class Lock, class Condition>
+inline bool mockWait(std::condition_variable& wake, Lock& lock, TickType_t ticks, Condition condition)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        wake.wait(lock, condition);
+        return true;
+    }
+    return wake.wait_for(lock, std::chrono::milliseconds(ticks), condition);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::recursive_timed_mutex();
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+    delete mutex;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait)
+{
+    if (wait == portMAX_DELAY)
+    {
+        mutex->lock();
+        return pdTRUE;
+    }
+    return mutex->try_lock_for(std::chrono::milliseconds(wait)) ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    mutex->unlock();
+    return pdTRUE;
+}
+
+inline EventGroupHandle_t xEventGroupCreate()
+{
+    return new MockEventGroup();
+}
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    return group->bits |= bits;
+}
+
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t, TickType_t)
+{
+    EventBits_t current = group->bits;
+    if (clear)
+        group->bits &= ~bits;
+    return current;
+}
+
+// the task of the calling thread, threads not started by xTaskCreate get one on first use that
+// ends with the thread
+inline TaskHandle_t& mockCurrentTask()
+{
+    static thread_local TaskHandle_t task = nullptr;
+    return task;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    static thread_local std::unique_ptr<MockTask> owned;
+    TaskHandle_t& task = mockCurrentTask();
+    if (task == nullptr)
+    {
+        owned.reset(new MockTask());
+        owned->name = "main";
+        task = owned.get();
+    }
+    return task;
+}
+
+inline const char* pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : xTaskGetCurrentTaskHandle())->name.c_str();
+}
+
+// the handle is set before the task runs, the task never ends before the process does
+inline BaseType_t xTaskCreate(void (*function)(void*), const char* name, uint32_t, void* parameter, UBaseType_t, TaskHandle_t* handle)
+{
+    TaskHandle_t task = new MockTask();
+    task->name = name;
+    if (handle)
+        *handle = task;
+    std::thread([=]() {
+        mockCurrentTask() = task;
+        function(parameter);
+    }).detach();
+    return pdPASS;
+}
+
+inline TickType_t xTaskGetTickCount()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if (task == nullptr)
+        return pdFAIL;
+    std::lock_guard<std::mutex> lock(task->mutex);
+    if (action == eSetValueWithoutOverwrite && task->pending)
+        return pdFAIL;
+    switch (action)
+    {
+        case eSetBits: task->value |= value; break;
+        case eIncrement: task->value++; break;
+        case eSetValueWithOverwrite:
+        case eSetValueWithoutOverwrite: task->value = value; break;
+        case eNoAction: break;
+    }
+    task->pending = true;
+    task->wake.notify_all();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+{
+    xTaskNotifyGive(task);
+    if (woken)
+        *woken = pdTRUE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    mockWait(task->wake, lock, ticks, [task]() { return task->value != 0; });
+    uint32_t value = task->value;
+    if (value)
+        task->value = clear ? 0 : value - 1;
+    task->pending = false;
+    return value;
+}
+
+inline BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value, TickType_t ticks)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    if (not task->pending)
+        task->value &= ~clearOnEntry;
+    bool notified = mockWait(task->wake, lock, ticks, [task]() { return task->pending; });
+    if (value)
+        *value = task->value;
+    if (notified)
+    {
+        task->value &= ~clearOnExit;
+        task->pending = false;
+    }
+    return notified ? pdTRUE : pdFALSE;
+}
+
+struct MockQueue
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+typedef MockQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    QueueHandle_t queue = new MockQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (not mockWait(queue->changed, lock, ticks, [queue]() { return queue->items.size() < queue->length; }))
+        return pdFALSE;
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (not mockWait(queue->changed, lock, ticks, [queue]() { return not queue->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+#endif // MOCK_FREERTOS_H
@@ -0,0 +1,31 @@
+#ifndef MOCK_NATIVE_RUNTIME_HPP
+#define MOCK_NATIVE_RUNTIME_HPP
+
+// The globals of the mocks and the parts of the firmware the headers call into but the
+// suites don't build (test_build_src = no). Included by exactly one file per suite.
+
+#include <Arduino.h>
+#include <metrics.hpp>
+
+MockSerial Serial;
+std::vector<MockBusEvent> busLog;
+
+Metrics::Metrics() {}
+void Metrics::addTask(TaskHandle_t, uint32_t) {}
+void Metrics::recordDuration(const char*, uint32_t) {}
+
+#ifdef MOCK_LITTLEFS_H
+MockFS LittleFS;
+#endif
+
+#ifdef MOCK_SPI_H
+SPIClass SPI;
+#endif
+
+// the mirror task is not part of the suites, `mirroredFrames` counts what would have been queued
+#ifdef FRAME_MIRROR_HPP
+size_t mirroredFrames = 0;
+void FrameMirror::publish(const uint8_t*, uint8_t) { mirroredFrames++; }
+#endif
+
+#endif // MOCK_NATIVE_RUNTIME_HPP
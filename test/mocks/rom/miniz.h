@@ -0,0 +1,107 @@
+#ifndef MOCK_ROM_MINIZ_H
+#define MOCK_ROM_MINIZ_H
+
+// Host stand-in for the tinfl inflater in the ESP32 ROM, backed by zlib (link with -lz).
+// Same calls, flags and status codes. The output goes where tinfl puts it, but zlib keeps its
+// own window, so the dictionary before the output pointer is not read. zlib also checks the
+// Adler-32 of a zlib stream, which tinfl only does with TINFL_FLAG_COMPUTE_ADLER32.
+// The zlib state lives in an arena inside the decompressor, freeing it frees everything,
+// like the plain struct of the real tinfl.
+
+#include <cstddef>
+#include <cstdint>
+#include <zlib.h>
+
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum
+{
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8,
+};
+
+typedef enum
+{
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+struct tinfl_decompressor
+{
+    bool started;
+    bool finished;
+    z_stream stream;
+    size_t used;
+    alignas(16) uint8_t arena[48 * 1024];    // inflate state and its 32 KB window
+};
+
+inline voidpf mockMinizAlloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor* r = static_cast<tinfl_decompressor*>(opaque);
+    size_t bytes = (size_t(items) * size + 15) & ~size_t(15);
+    if (r->used + bytes > sizeof(r->arena))
+        return Z_NULL;
+    void* memory = r->arena + r->used;
+    r->used += bytes;
+    return memory;
+}
+
+inline void mockMinizFree(voidpf, voidpf) {}
+
+inline void tinfl_init(tinfl_decompressor* r)
+{
+    r->started = false;
+    r->finished = false;
+    r->used = 0;
+}
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* inSize,
+    uint8_t* outStart, uint8_t* outNext, size_t* outSize, mz_uint32 flags)
+{
+    (void)outStart;
+    if (r->finished)
+    {
+        *inSize = 0;
+        *outSize = 0;
+        return TINFL_STATUS_DONE;
+    }
+    if (not r->started)
+    {
+        r->stream = z_stream();
+        r->stream.zalloc = mockMinizAlloc;
+        r->stream.zfree = mockMinizFree;
+        r->stream.opaque = r;
+        if (inflateInit2(&r->stream, (flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK)
+            return TINFL_STATUS_BAD_PARAM;
+        r->started = true;
+    }
+
+    r->stream.next_in = const_cast<Bytef*>(in);
+    r->stream.avail_in = uInt(*inSize);
+    r->stream.next_out = outNext;
+    r->stream.avail_out = uInt(*outSize);
+    int result = inflate(&r->stream, Z_NO_FLUSH);
+    *inSize -= r->stream.avail_in;
+    *outSize -= r->stream.avail_out;
+
+    if (result == Z_STREAM_END)
+    {
+        r->finished = true;
+        return TINFL_STATUS_DONE;
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR)
+        return TINFL_STATUS_FAILED;
+    if (r->stream.avail_out == 0)
+        return TINFL_STATUS_HAS_MORE_OUTPUT;
+    return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+#endif // MOCK_ROM_MINIZ_H
@@ -0,0 +1,207 @@
+// Host tests of the config line parser and writer: pio test -e native -f test_config_line
+#include <unity.h>
+#include <config_line.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// collects what write_value() writes
+struct StringOut
+{
+    size_t write(uint8_t c)
+    {
+        text += char(c);
+        return 1;
+    }
+
+    size_t write(const uint8_t* data, size_t len)
+    {
+        text.append(reinterpret_cast<const char*>(data), len);
+        return len;
+    }
+
+    std::string text;
+};
+
+struct Parsed
+{
+    bool ok;
+    std::string key;
+    std::string value;
+    std::string error;
+};
+
+// parses one line the way load_from_file() does: in a buffer that also holds the rest of the file
+static Parsed parse(const std::string& line)
+{
+    std::vector<char> buffer(line.begin(), line.end());
+    buffer.push_back('\n');
+    buffer.push_back('X');
+
+    char* key = nullptr;
+    char* value = nullptr;
+    const char* error = nullptr;
+    Parsed parsed;
+    parsed.ok = ConfigLine::parse_line(buffer.data(), buffer.data() + line.size(), key, value, error);
+    if (parsed.ok)
+    {
+        parsed.key = key;
+        parsed.value = value;
+    }
+    if (error)
+        parsed.error = error;
+    TEST_ASSERT_EQUAL_MESSAGE('X', buffer.back(), "wrote past the line");
+    return parsed;
+}
+
+static std::string written(const std::string& value)
+{
+    StringOut out;
+    TEST_ASSERT_TRUE(ConfigLine::write_value(out, value.c_str()));
+    return out.text;
+}
+
+void setUp() { srand(1); }
+void tearDown() {}
+
+void test_plain_values_are_trimmed()
+{
+    Parsed p = parse("  name   =  some value  ");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("name", p.key.c_str());
+    TEST_ASSERT_EQUAL_STRING("some value", p.value.c_str());
+
+    p = parse("url=http://host/#anchor");
+    TEST_ASSERT_EQUAL_STRING("http://host/#anchor", p.value.c_str());
+
+    p = parse("empty=");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("", p.value.c_str());
+}
+
+void test_blank_lines_and_comments_are_skipped_without_error()
+{
+    for (const char* line : {"", "   ", "\r", "# comment", "   # indented = comment"})
+    {
+        Parsed p = parse(line);
+        TEST_ASSERT_FALSE(p.ok);
+        TEST_ASSERT_EQUAL_STRING("", p.error.c_str());
+    }
+}
+
+void test_crlf_line_endings()
+{
+    Parsed p = parse("key=value\r");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("value", p.value.c_str());
+
+    p = parse("key=\"quoted \"\r");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("quoted ", p.value.c_str());
+}
+
+void test_empty_keys_and_missing_delimiter()
+{
+    TEST_ASSERT_EQUAL_STRING("empty key", parse("=value").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("empty key", parse("   = value").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("missing '='", parse("just text").error.c_str());
+}
+
+void test_quotes_and_escapes()
+{
+    Parsed p = parse("q = \"  a \\\"b\\\" \\\\ \\n\\t end \" # comment");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("  a \"b\" \\ \n\t end ", p.value.c_str());
+
+    p = parse("s = 'raw \\n \"'");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("raw \\n \"", p.value.c_str());
+}
+
+void test_unterminated_quotes()
+{
+    TEST_ASSERT_EQUAL_STRING("missing closing quote", parse("k=\"open").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("missing closing quote", parse("k='open").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("missing closing quote", parse("k=\"").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("text after the closing quote", parse("k=\"a\" b").error.c_str());
+}
+
+void test_escape_at_end_of_line()
+{
+    //the backslash has nothing to escape, the quote stays open
+    TEST_ASSERT_EQUAL_STRING("missing closing quote", parse("k=\"abc\\").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("missing closing quote", parse("k=\"abc\\\"").error.c_str());
+    TEST_ASSERT_EQUAL_STRING("missing closing quote", parse("k=\"abc\\\r").error.c_str());
+
+    Parsed p = parse("k=abc\\");
+    TEST_ASSERT_TRUE(p.ok);
+    TEST_ASSERT_EQUAL_STRING("abc\\", p.value.c_str());
+}
+
+void test_write_quotes_only_when_needed()
+{
+    TEST_ASSERT_EQUAL_STRING("plain value", written("plain value").c_str());
+    TEST_ASSERT_EQUAL_STRING("back\\slash", written("back\\slash").c_str());
+    TEST_ASSERT_EQUAL_STRING("", written("").c_str());
+    TEST_ASSERT_EQUAL_STRING("\" padded \"", written(" padded ").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"two\\nlines\"", written("two\nlines").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"\\\"quoted\\\" \\\\\"", written("\"quoted\" \\").c_str());
+}
+
+void test_write_then_parse_round_trip()
+{
+    static const char alphabet[] = "ab =#\"'\\\n\r\t";
+    for (int i = 0; i < 20000; i++)
+    {
+        std::string value;
+        size_t length = rand() % 12;
+        for (size_t c = 0; c < length; c++)
+            value += rand() % 4 ? alphabet[rand() % (sizeof(alphabet) - 1)] : char(0x20 + rand() % 0x5F);
+
+        std::string line = "key=" + written(value);
+        TEST_ASSERT_TRUE_MESSAGE(line.find('\n') == std::string::npos, "written value spans lines");
+        Parsed p = parse(line);
+        TEST_ASSERT_TRUE_MESSAGE(p.ok, line.c_str());
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(value.c_str(), p.value.c_str(), line.c_str());
+    }
+}
+
+// random bytes must never crash or write outside the line, whatever the result
+void test_random_lines()
+{
+    static const char alphabet[] = "k= \"'\\#\r\t";
+    for (int i = 0; i < 50000; i++)
+    {
+        std::string line;
+        size_t length = rand() % 24;
+        for (size_t c = 0; c < length; c++)
+            line += rand() % 3 ? alphabet[rand() % (sizeof(alphabet) - 1)] : char(1 + rand() % 255);
+        //a line never contains the newline that ends it
+        for (auto& c : line)
+            if (c == '\n')
+                c = ' ';
+
+        Parsed p = parse(line);
+        if (p.ok)
+            TEST_ASSERT_TRUE(not p.key.empty() && p.key.size() <= line.size() && p.value.size() <= line.size());
+        else if (not p.error.empty())
+            TEST_ASSERT_TRUE(p.key.empty());
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_values_are_trimmed);
+    RUN_TEST(test_blank_lines_and_comments_are_skipped_without_error);
+    RUN_TEST(test_crlf_line_endings);
+    RUN_TEST(test_empty_keys_and_missing_delimiter);
+    RUN_TEST(test_quotes_and_escapes);
+    RUN_TEST(test_unterminated_quotes);
+    RUN_TEST(test_escape_at_end_of_line);
+    RUN_TEST(test_write_quotes_only_when_needed);
+    RUN_TEST(test_write_then_parse_round_trip);
+    RUN_TEST(test_random_lines);
+    return UNITY_END();
+}
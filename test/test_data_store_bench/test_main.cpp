@@ -0,0 +1,147 @@
+// Lookup latency and heap footprint of DataStore against the std::map<std::string, std::string>
+// it replaced, for 10 to 500 keys: pio test -e native -f test_data_store_bench
+#include <unity.h>
+#include <data_store.hpp>
+#include <native_runtime.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every allocation of the suite goes through here, `allocated` is what is live right now
+static size_t allocated = 0;
+
+void* operator new(size_t size)
+{
+    size_t* block = static_cast<size_t*>(malloc(size + sizeof(max_align_t)));
+    if (block == nullptr)
+        throw std::bad_alloc();
+    *block = size;
+    allocated += size;
+    return reinterpret_cast<char*>(block) + sizeof(max_align_t);
+}
+
+void operator delete(void* memory) noexcept
+{
+    if (memory == nullptr)
+        return;
+    size_t* block = reinterpret_cast<size_t*>(static_cast<char*>(memory) - sizeof(max_align_t));
+    allocated -= *block;
+    free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+void operator delete(void* memory, size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory, size_t) noexcept { operator delete(memory); }
+
+static const char CONFIG[] = "/bench.txt";
+static const int LOOKUPS = 200000;
+
+typedef std::chrono::steady_clock Clock;
+
+static std::string keyName(int i)
+{
+    char name[24];
+    snprintf(name, sizeof(name), "setting_%03d", i);
+    return name;
+}
+
+// the log of load_from_file is not part of the footprint
+static void dropLog()
+{
+    Serial.output.clear();
+    Serial.output.shrink_to_fit();
+}
+
+static double nsPerLookup(Clock::time_point start, int lookups)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_store_holds_the_benchmarked_range()
+{
+    TEST_ASSERT_TRUE(DataStore::MAX_KEYS >= 500);
+}
+
+void test_lookup_latency_and_footprint()
+{
+    dropLog();
+    size_t before = allocated;
+    auto& store = DataStore::getInstance();
+    size_t storeBytes = allocated - before;
+
+    for (int keys : {10, 50, 100, 250, 500})
+    {
+        std::vector<std::string> names;
+        for (int i = 0; i < keys; i++)
+            names.push_back(keyName(i));
+
+        //the old store: a map filled line by line
+        before = allocated;
+        std::map<std::string, std::string>* map = new std::map<std::string, std::string>();
+        for (int i = 0; i < keys; i++)
+            (*map)[names[i]] = std::to_string(i * 7);
+        size_t mapBytes = allocated - before;
+
+        //keys are never removed, every round loads the whole set again and the values of the
+        //last round are freed
+        std::string config;
+        for (int i = 0; i < keys; i++)
+            config += names[i] + " = " + std::to_string(i * 7) + "\n";
+        File file = LittleFS.open(CONFIG, "w");
+        file.print(config.c_str());
+        file.close();
+
+        before = allocated;
+        store.load_from_file(CONFIG);
+        dropLog();
+        storeBytes += allocated - before;
+
+        std::vector<DataStore::Key> handles;
+        for (int i = 0; i < keys; i++)
+        {
+            handles.push_back(store.key(names[i]));
+            TEST_ASSERT_EQUAL(i * 7, store.get_int(handles.back(), -1));
+        }
+
+        volatile long sink = 0;
+        auto start = Clock::now();
+        for (int i = 0; i < LOOKUPS; i++)
+            sink += map->find(names[i % keys])->second.size();
+        double mapNs = nsPerLookup(start, LOOKUPS);
+
+        start = Clock::now();
+        for (int i = 0; i < LOOKUPS; i++)
+            sink += store.has_key(names[i % keys]);
+        double nameNs = nsPerLookup(start, LOOKUPS);
+
+        start = Clock::now();
+        for (int i = 0; i < LOOKUPS; i++)
+            sink += store.get_int(handles[i % keys]);
+        double handleNs = nsPerLookup(start, LOOKUPS);
+        (void)sink;
+
+        delete map;
+
+        char message[160];
+        snprintf(message, sizeof(message),
+            "%3d keys: map %5.1f ns %6u B | store by name %5.1f ns, by handle %4.1f ns, %6u B",
+            keys, mapNs, (unsigned)mapBytes, nameNs, handleNs, (unsigned)storeBytes);
+        TEST_MESSAGE(message);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_store_holds_the_benchmarked_range);
+    RUN_TEST(test_lookup_latency_and_footprint);
+    return UNITY_END();
+}
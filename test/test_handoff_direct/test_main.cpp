@@ -0,0 +1,3 @@
+// Hand-off latency of the direct backend: pio test -e native -f test_handoff_direct
+#define RESOURCE_MANAGER_DIRECT_HANDOFF 1
+#include "../handoff_bench.hpp"
@@ -0,0 +1,3 @@
+// Hand-off latency of the manager task backend: pio test -e native -f test_handoff_task
+#define RESOURCE_MANAGER_DIRECT_HANDOFF 0
+#include "../handoff_bench.hpp"
@@ -0,0 +1,175 @@
+// InflateSink on gzip and zlib fixtures (next to this file, made with Python's gzip and zlib
+// modules), with the ROM inflater stood in by zlib: pio test -e native -f test_inflate
+#include <unity.h>
+#include <inflate_sink.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using HttpUtils::HttpSink;
+using HttpUtils::InflateSink;
+
+static std::string fixture(const char* name)
+{
+    std::string path = __FILE__;
+    path = path.substr(0, path.find_last_of("/\\") + 1) + name;
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    TEST_ASSERT_TRUE_MESSAGE(content.str().size() > 0, name);
+    return content.str();
+}
+
+// collects the body, satisfied once it has `wanted` bytes, aborts after `abortAfter`
+class CollectSink : public HttpSink
+{
+public:
+    bool onData(const uint8_t* data, size_t len) override
+    {
+        body.append(reinterpret_cast<const char*>(data), len);
+        calls++;
+        return body.size() < abortAfter;
+    }
+
+    bool satisfied() const override { return body.size() >= wanted; }
+
+    std::string body;
+    size_t calls = 0;
+    size_t wanted = SIZE_MAX;
+    size_t abortAfter = SIZE_MAX;
+};
+
+// what pumpBody() does: pieces of `chunk` bytes, nothing more once the sink is satisfied or aborted.
+// Returns what httpGetStream() makes of the response
+static int pump(InflateSink& sink, const std::string& body, size_t chunk)
+{
+    for (size_t offset = 0; offset < body.size() && not sink.satisfied(); offset += chunk)
+    {
+        if (not sink.onData(reinterpret_cast<const uint8_t*>(body.data()) + offset, std::min(chunk, body.size() - offset)))
+            break;
+    }
+    return sink.result(HTTP_CODE_OK);
+}
+
+static std::string json;
+
+void setUp()
+{
+    if (json.empty())
+        json = fixture("forecast.json");
+}
+
+void tearDown() {}
+
+static void checkInflates(const char* name, bool gzip)
+{
+    std::string compressed = fixture(name);
+    for (size_t chunk : {size_t(1), size_t(7), size_t(512), compressed.size()})
+    {
+        CollectSink target;
+        InflateSink inflate(target, gzip);
+        TEST_ASSERT_EQUAL_MESSAGE(HTTP_CODE_OK, pump(inflate, compressed, chunk), name);
+        TEST_ASSERT_FALSE(inflate.failed());
+        TEST_ASSERT_TRUE_MESSAGE(target.body == json, name);
+        TEST_ASSERT_EQUAL(compressed.size(), inflate.compressedBytes());
+        TEST_ASSERT_EQUAL(json.size(), inflate.decompressedBytes());
+    }
+}
+
+void test_gzip()
+{
+    //more than the 32 KB dictionary, the output wraps around in it
+    TEST_ASSERT_TRUE(json.size() > TINFL_LZ_DICT_SIZE);
+    checkInflates("forecast.json.gz", true);
+}
+
+void test_gzip_with_every_optional_header_field()
+{
+    //FEXTRA (with a zero byte in it), FNAME, FCOMMENT and FHCRC
+    std::string compressed = fixture("header_fields.gz");
+    TEST_ASSERT_EQUAL_HEX8(0x1E, uint8_t(compressed[3]));
+    checkInflates("header_fields.gz", true);
+}
+
+void test_zlib()
+{
+    checkInflates("forecast.json.zz", false);
+}
+
+void test_corrupt_stream_fails_with_encoding_error()
+{
+    //a stored block with "hello", then a block of the reserved type
+    CollectSink target;
+    InflateSink inflate(target, true);
+    TEST_ASSERT_EQUAL(HTTPC_ERROR_ENCODING, pump(inflate, fixture("corrupt.gz"), 7));
+    TEST_ASSERT_TRUE(inflate.failed());
+    TEST_ASSERT_EQUAL_STRING("hello", target.body.c_str());
+}
+
+void test_wrong_magic_fails_with_encoding_error()
+{
+    //a zlib stream announced as gzip, and a gzip stream announced as deflate
+    CollectSink gzipTarget;
+    InflateSink gzip(gzipTarget, true);
+    TEST_ASSERT_EQUAL(HTTPC_ERROR_ENCODING, pump(gzip, fixture("forecast.json.zz"), 512));
+    TEST_ASSERT_EQUAL(0, gzipTarget.calls);
+
+    CollectSink zlibTarget;
+    InflateSink zlib(zlibTarget, false);
+    TEST_ASSERT_EQUAL(HTTPC_ERROR_ENCODING, pump(zlib, fixture("forecast.json.gz"), 512));
+    TEST_ASSERT_EQUAL(0, zlibTarget.calls);
+}
+
+void test_truncated_stream_fails_with_encoding_error()
+{
+    std::string compressed = fixture("forecast.json.gz");
+    for (size_t length : {size_t(5), size_t(20), compressed.size() / 2})
+    {
+        CollectSink target;
+        InflateSink inflate(target, true);
+        TEST_ASSERT_EQUAL(HTTPC_ERROR_ENCODING, pump(inflate, compressed.substr(0, length), 7));
+        TEST_ASSERT_FALSE(inflate.failed());
+        TEST_ASSERT_TRUE(json.compare(0, target.body.size(), target.body) == 0);
+    }
+
+    //the deflate data is complete, only the trailer is missing: nothing the sink cares about
+    CollectSink target;
+    InflateSink inflate(target, true);
+    TEST_ASSERT_EQUAL(HTTP_CODE_OK, pump(inflate, compressed.substr(0, compressed.size() - 8), 7));
+    TEST_ASSERT_TRUE(target.body == json);
+}
+
+void test_satisfied_target_stops_inflating()
+{
+    CollectSink target;
+    target.wanted = 1000;
+    InflateSink inflate(target, true);
+    TEST_ASSERT_EQUAL(HTTP_CODE_OK, pump(inflate, fixture("forecast.json.gz"), 7));
+    TEST_ASSERT_TRUE(inflate.satisfied());
+    TEST_ASSERT_TRUE(target.body.size() >= 1000 && target.body.size() < json.size());
+}
+
+void test_aborting_target_is_not_an_encoding_error()
+{
+    CollectSink target;
+    target.abortAfter = 100;
+    InflateSink inflate(target, false);
+    TEST_ASSERT_EQUAL(HTTP_CODE_OK, pump(inflate, fixture("forecast.json.zz"), 512));
+    TEST_ASSERT_FALSE(inflate.failed());
+    TEST_ASSERT_EQUAL(1, target.calls);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gzip);
+    RUN_TEST(test_gzip_with_every_optional_header_field);
+    RUN_TEST(test_zlib);
+    RUN_TEST(test_corrupt_stream_fails_with_encoding_error);
+    RUN_TEST(test_wrong_magic_fails_with_encoding_error);
+    RUN_TEST(test_truncated_stream_fails_with_encoding_error);
+    RUN_TEST(test_satisfied_target_stops_inflating);
+    RUN_TEST(test_aborting_target_is_not_an_encoding_error);
+    return UNITY_END();
+}
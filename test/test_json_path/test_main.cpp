@@ -0,0 +1,211 @@
+// Host tests of the streaming JSON path matcher: pio test -e native -f test_json_path
+#include <unity.h>
+#include <json_path_matcher.hpp>
+
+#include <cstdio>
+#include <string>
+
+// the tables of weather_forecast_task.cpp
+static constexpr JsonPathNode weatherPaths[] = {
+    { -1, "main", 0, -1 },
+    {  0, "temp", 0, 0 },
+};
+
+static constexpr JsonPathNode forecastPaths[] = {
+    { -1, "list", 0, -1 },
+    {  0, nullptr, 2, -1 },
+    {  1, "main", 0, -1 },
+    {  2, "temp", 0, 0 },
+    {  1, "weather", 0, -1 },
+    {  4, nullptr, 0, -1 },
+    {  5, "description", 0, 1 },
+    { -1, "city", 0, -1 },
+    {  7, "name", 0, 2 },
+};
+enum ForecastSlot { FORECAST_TEMP, FORECAST_DESCRIPTION, CITY_NAME };
+
+typedef JsonPathMatcher<JsonPath::slotCount(weatherPaths)> WeatherMatcher;
+typedef JsonPathMatcher<JsonPath::slotCount(forecastPaths)> ForecastMatcher;
+
+// A 5 day / 3 hour forecast the way OpenWeatherMap sends it: 40 entries in "list", "city" after them
+static std::string forecastDocument()
+{
+    static const char* const descriptions[] = { "clear sky", "few clouds", "light rain", "overcast clouds" };
+    std::string json = "{\"cod\":\"200\",\"message\":0,\"cnt\":40,\"list\":[";
+    char entry[640];
+    for (int i = 0; i < 40; i++)
+    {
+        snprintf(entry, sizeof(entry),
+            "%s{\"dt\":%d,\"main\":{\"temp\":%.2f,\"feels_like\":%.2f,\"temp_min\":%.2f,\"temp_max\":%.2f,"
+            "\"pressure\":1016,\"sea_level\":1016,\"grnd_level\":941,\"humidity\":%d,\"temp_kf\":-0.4},"
+            "\"weather\":[{\"id\":500,\"main\":\"Rain\",\"description\":\"%s\",\"icon\":\"10d\"}],"
+            "\"clouds\":{\"all\":%d},\"wind\":{\"speed\":2.06,\"deg\":219,\"gust\":3.1},\"visibility\":10000,"
+            "\"pop\":0.32,\"rain\":{\"3h\":0.21},\"sys\":{\"pod\":\"d\"},\"dt_txt\":\"2026-10-%02d %02d:00:00\"}",
+            i ? "," : "", 1792144800 + i * 10800, 10.0 + i * 0.25, 9.5 + i * 0.25, 9.0 + i * 0.25, 11.0 + i * 0.25,
+            60 + i % 30, descriptions[i % 4], i * 2, 17 + i / 8, i % 8 * 3);
+        json += entry;
+    }
+    json += "],\"city\":{\"id\":2659667,\"name\":\"Meyrin\",\"coord\":{\"lat\":46.2342,\"lon\":6.0803},"
+        "\"country\":\"CH\",\"population\":19976,\"timezone\":7200,\"sunrise\":1792131386,\"sunset\":1792171027}}";
+    return json;
+}
+
+template <class Matcher>
+static void feed(Matcher& matcher, const std::string& json, size_t chunk)
+{
+    for (size_t offset = 0; offset < json.size(); offset += chunk)
+        matcher.feed(reinterpret_cast<const uint8_t*>(json.data()) + offset, std::min(chunk, json.size() - offset));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_forecast_in_1_and_5_byte_chunks()
+{
+    std::string json = forecastDocument();
+    TEST_ASSERT_TRUE(json.size() > 15000);
+    for (size_t chunk : {size_t(1), size_t(5), json.size()})
+    {
+        ForecastMatcher matcher(forecastPaths);
+        feed(matcher, json, chunk);
+        TEST_ASSERT_TRUE(matcher.complete());
+        TEST_ASSERT_TRUE(matcher.done());
+        TEST_ASSERT_EQUAL_STRING("10.50", matcher.value(FORECAST_TEMP));
+        TEST_ASSERT_EQUAL_STRING("light rain", matcher.value(FORECAST_DESCRIPTION));
+        TEST_ASSERT_EQUAL_STRING("Meyrin", matcher.value(CITY_NAME));
+    }
+}
+
+void test_input_after_done_is_ignored()
+{
+    WeatherMatcher matcher(weatherPaths);
+    feed(matcher, "{\"main\":{\"temp\":7.5}}", 1);
+    TEST_ASSERT_TRUE(matcher.done());
+    feed(matcher, "{\"main\":{\"temp\":99}}", 1);
+    TEST_ASSERT_EQUAL_STRING("7.5", matcher.value(0));
+}
+
+void test_unwanted_containers_are_skipped()
+{
+    //wanted keys inside unwanted containers, brackets and quotes inside their strings
+    WeatherMatcher matcher(weatherPaths);
+    feed(matcher,
+        "{\"other\":{\"main\":{\"temp\":1}},"
+        "\"list\":[{\"main\":{\"temp\":2}},\"]}{[\",{\"s\":\"}\\\"]\"}],"
+        "\"nested\":[[[[{\"temp\":3}]]]],"
+        "\"main\":{\"feels\":{\"temp\":4},\"temp\":-3.25,\"after\":[1,2]}}", 1);
+    TEST_ASSERT_TRUE(matcher.complete());
+    TEST_ASSERT_EQUAL_STRING("-3.25", matcher.value(0));
+
+    //literal values of every type before the wanted one
+    WeatherMatcher literals(weatherPaths);
+    feed(literals, "{\"a\":true,\"b\":null,\"c\":-1e5,\"main\":{\"x\":false,\"temp\":0}}", 5);
+    TEST_ASSERT_EQUAL_STRING("0", literals.value(0));
+}
+
+void test_array_index_paths()
+{
+    ForecastMatcher matcher(forecastPaths);
+    //list[2] has no weather array, the description of another index must not be taken
+    feed(matcher,
+        "{\"list\":[{\"weather\":[{\"description\":\"a\"}]},[],"
+        "{\"main\":{\"temp\":5},\"weather\":[]},{\"weather\":[{\"description\":\"d\"}]}],"
+        "\"city\":{\"name\":\"X\"}}", 1);
+    TEST_ASSERT_FALSE(matcher.complete());
+    TEST_ASSERT_TRUE(matcher.done());
+    TEST_ASSERT_TRUE(matcher.has(FORECAST_TEMP));
+    TEST_ASSERT_FALSE(matcher.has(FORECAST_DESCRIPTION));
+    TEST_ASSERT_EQUAL_STRING("", matcher.value(FORECAST_DESCRIPTION));
+}
+
+void test_escapes_in_keys_and_values()
+{
+    static constexpr JsonPathNode paths[] = {
+        { -1, "city", 0, -1 },
+        {  0, "name", 0, 0 },
+    };
+    JsonPathMatcher<1> matcher(paths);
+    //an escaped quote does not end the key or the value, escapes keep the escaped character
+    feed(matcher, "{\"ci\\\"ty\":{\"name\":1},\"city\":{\"na\\\\me\":2,\"name\":\"Saint \\\"Genis\\\" \\\\ \\/x\"}}", 1);
+    TEST_ASSERT_TRUE(matcher.complete());
+    TEST_ASSERT_EQUAL_STRING("Saint \"Genis\" \\ /x", matcher.value(0));
+
+    //\uXXXX is not decoded, the u and the digits stay
+    JsonPathMatcher<1> unicode(paths);
+    feed(unicode, "{\"city\":{\"name\":\"Gen\\u00e8ve\"}}", 5);
+    TEST_ASSERT_EQUAL_STRING("Genu00e8ve", unicode.value(0));
+}
+
+void test_keys_longer_than_the_key_buffer()
+{
+    //31 characters fit, a longer key that starts with the same 31 is not the same key
+    static constexpr JsonPathNode paths[] = {
+        { -1, "abcdefghijklmnopqrstuvwxyz01234", 0, 0 },
+    };
+    JsonPathMatcher<1> matcher(paths);
+    feed(matcher,
+        "{\"abcdefghijklmnopqrstuvwxyz012345\":\"long\","
+        "\"abcdefghijklmnopqrstuvwxyz01234567890123456789\":{\"x\":\"skipped\"},"
+        "\"abcdefghijklmnopqrstuvwxyz01234\":\"exact\"}", 1);
+    TEST_ASSERT_TRUE(matcher.complete());
+    TEST_ASSERT_EQUAL_STRING("exact", matcher.value(0));
+
+    //an overflowing key does not leak into the next one
+    WeatherMatcher next(weatherPaths);
+    feed(next, "{\"main\":{\"temptemptemptemptemptemptemptemptemp\":1,\"temp\":2}}", 1);
+    TEST_ASSERT_EQUAL_STRING("2", next.value(0));
+}
+
+void test_values_are_cut_at_value_size()
+{
+    static constexpr JsonPathNode paths[] = {
+        { -1, "s", 0, 0 },
+        { -1, "n", 0, 1 },
+    };
+    JsonPathMatcher<2, 8> matcher(paths);
+    feed(matcher, "{\"s\":\"abcdefghijklmnop\",\"n\":1234567890123}", 1);
+    TEST_ASSERT_TRUE(matcher.complete());
+    TEST_ASSERT_EQUAL_STRING("abcdefg", matcher.value(0));
+    TEST_ASSERT_EQUAL_STRING("1234567", matcher.value(1));
+}
+
+void test_truncated_body()
+{
+    std::string json = forecastDocument();
+    //cut inside the city object, after list[2] was complete
+    std::string truncated = json.substr(0, json.find("\"name\":\"Meyrin\"") + 10);
+
+    ForecastMatcher matcher(forecastPaths);
+    feed(matcher, truncated, 5);
+    TEST_ASSERT_FALSE(matcher.complete());
+    TEST_ASSERT_FALSE(matcher.done());
+    TEST_ASSERT_TRUE(matcher.has(FORECAST_TEMP));
+    TEST_ASSERT_TRUE(matcher.has(FORECAST_DESCRIPTION));
+    TEST_ASSERT_FALSE(matcher.has(CITY_NAME));
+
+    //cut inside a number: a literal only counts once something ends it
+    WeatherMatcher number(weatherPaths);
+    feed(number, "{\"main\":{\"temp\":12.", 1);
+    TEST_ASSERT_FALSE(number.has(0));
+    TEST_ASSERT_FALSE(number.done());
+
+    //a complete document without the wanted path is done, but not complete
+    WeatherMatcher missing(weatherPaths);
+    feed(missing, "{\"main\":{\"humidity\":60}}", 1);
+    TEST_ASSERT_TRUE(missing.done());
+    TEST_ASSERT_FALSE(missing.complete());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_forecast_in_1_and_5_byte_chunks);
+    RUN_TEST(test_input_after_done_is_ignored);
+    RUN_TEST(test_unwanted_containers_are_skipped);
+    RUN_TEST(test_array_index_paths);
+    RUN_TEST(test_escapes_in_keys_and_values);
+    RUN_TEST(test_keys_longer_than_the_key_buffer);
+    RUN_TEST(test_values_are_cut_at_value_size);
+    RUN_TEST(test_truncated_body);
+    return UNITY_END();
+}
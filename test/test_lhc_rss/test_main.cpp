@@ -0,0 +1,200 @@
+// The LHC field extractor on a copy of the ALICE DCS feed (rss.xml next to this file), with
+// allocation count and time per parse: pio test -e native -f test_lhc_rss
+#include <unity.h>
+#include <lhc_field_extractor.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+// every allocation of the suite goes through here
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* memory = malloc(size ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+void operator delete(void* memory, size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory, size_t) noexcept { operator delete(memory); }
+
+typedef std::chrono::steady_clock Clock;
+typedef LhcFieldExtractor Lhc;
+
+static int64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static std::string rss;
+
+static std::string readFixture()
+{
+    std::string path = __FILE__;
+    path = path.substr(0, path.find_last_of("/\\") + 1) + "rss.xml";
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// feeds the body in pieces of `chunk` bytes, all of it even after satisfied() like the HTTP sink does
+static void feed(Lhc& extractor, const std::string& body, size_t chunk)
+{
+    for (size_t offset = 0; offset < body.size(); offset += chunk)
+        extractor.feed(reinterpret_cast<const uint8_t*>(body.data()) + offset, std::min(chunk, body.size() - offset));
+}
+
+static std::string item(const char* title)
+{
+    return std::string("<item>\n<title>") + title + "</title>\n<link>https://x/</link>\n</item>\n";
+}
+
+void setUp()
+{
+    if (rss.empty())
+        rss = readFixture();
+}
+
+void tearDown() {}
+
+void test_fixture_in_1_7_and_whole_body_chunks()
+{
+    TEST_ASSERT_TRUE_MESSAGE(rss.size() > 1000, "rss.xml not found");
+    for (size_t chunk : {size_t(1), size_t(7), rss.size()})
+    {
+        Lhc extractor(nowUs);
+        feed(extractor, rss, chunk);
+        TEST_ASSERT_TRUE(extractor.satisfied());
+        TEST_ASSERT_EQUAL(Lhc::FIELD_COUNT, extractor.foundCount());
+        TEST_ASSERT_EQUAL_STRING("Stable beams since 14:02--Next fill: 9877 ~22:00--Coordinator: ops",
+            extractor.value(Lhc::LhcPage1));
+        TEST_ASSERT_EQUAL_STRING("STABLE BEAMS", extractor.value(Lhc::LhcBeamMode));
+        TEST_ASSERT_EQUAL_STRING("6800 GeV", extractor.value(Lhc::BeamEnergy));
+        TEST_ASSERT_EQUAL_STRING("PROTON PHYSICS", extractor.value(Lhc::LhcMachineMode));
+    }
+}
+
+void test_satisfied_right_after_the_last_field()
+{
+    const char last[] = "<title>LhcMachineMode: PROTON PHYSICS</title>";
+    size_t end = rss.find(last) + strlen(last);
+
+    Lhc extractor(nowUs);
+    feed(extractor, rss.substr(0, end - 1), 1);
+    TEST_ASSERT_FALSE(extractor.satisfied());
+    feed(extractor, rss.substr(end - 1, 1), 1);
+    TEST_ASSERT_TRUE(extractor.satisfied());
+
+    //what comes after is ignored, even another title of a known key
+    feed(extractor, item("LhcBeamMode: NO BEAM"), 1);
+    TEST_ASSERT_EQUAL_STRING("STABLE BEAMS", extractor.value(Lhc::LhcBeamMode));
+}
+
+void test_line_breaks_become_dashes()
+{
+    Lhc extractor(nowUs);
+    feed(extractor, item("LhcPage1: a<br>b<br/>c <br> d"), 1);
+    TEST_ASSERT_TRUE(extractor.found(Lhc::LhcPage1));
+    TEST_ASSERT_EQUAL_STRING("a--b--c -- d", extractor.value(Lhc::LhcPage1));
+}
+
+void test_other_inline_tags_are_kept()
+{
+    Lhc extractor(nowUs);
+    feed(extractor, item("LhcPage1: <b>bold</b> and <span class=\"long\">span</span> end"), 7);
+    TEST_ASSERT_EQUAL_STRING("<b>bold</b> and <span class=\"long\">span</span> end", extractor.value(Lhc::LhcPage1));
+
+    //a tag longer than the tag buffer, with the closing title right behind it
+    Lhc longTag(nowUs);
+    feed(longTag, item("BeamEnergy: 450 GeV<font-weight-bold-very-long>"), 1);
+    TEST_ASSERT_EQUAL_STRING("450 GeV<font-weight-bold-very-long>", longTag.value(Lhc::BeamEnergy));
+}
+
+void test_missing_fields()
+{
+    std::string body = rss;
+    size_t energy = body.find("<title>BeamEnergy:");
+    body.replace(energy, strlen("<title>BeamEnergy"), "<title>OtherEnergy");
+
+    Lhc extractor(nowUs);
+    feed(extractor, body, 7);
+    TEST_ASSERT_FALSE(extractor.satisfied());
+    TEST_ASSERT_EQUAL(Lhc::FIELD_COUNT - 1, extractor.foundCount());
+    TEST_ASSERT_FALSE(extractor.found(Lhc::BeamEnergy));
+    TEST_ASSERT_EQUAL_STRING("", extractor.value(Lhc::BeamEnergy));
+    TEST_ASSERT_EQUAL_STRING("PROTON PHYSICS", extractor.value(Lhc::LhcMachineMode));
+
+    Lhc empty(nowUs);
+    feed(empty, "<rss><channel><title>ALICE DCS</title></channel></rss>", 1);
+    TEST_ASSERT_EQUAL(0, empty.foundCount());
+}
+
+void test_titles_that_are_not_fields()
+{
+    Lhc extractor(nowUs);
+    feed(extractor, item("LhcBeamMode without colon"), 1);
+    feed(extractor, item("AVeryLongKeyThatDoesNotFitTheBuffer: x"), 1);
+    feed(extractor, item("lhcbeammode: lower case"), 1);
+    feed(extractor, "<<title>LhcBeamMode:   INJECTION  \t</title>", 1);
+    TEST_ASSERT_EQUAL(1, extractor.foundCount());
+    TEST_ASSERT_EQUAL_STRING("INJECTION", extractor.value(Lhc::LhcBeamMode));
+}
+
+void test_long_values_are_cut()
+{
+    std::string value(300, 'x');
+    Lhc extractor(nowUs);
+    feed(extractor, item(("LhcPage1: " + value).c_str()), 7);
+    TEST_ASSERT_EQUAL(127, strlen(extractor.value(Lhc::LhcPage1)));
+}
+
+void test_allocations_and_time_per_parse()
+{
+    static const int PARSES = 2000;
+
+    size_t before = allocations;
+    int64_t parseUs = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < PARSES; i++)
+    {
+        Lhc extractor(nowUs);
+        feed(extractor, rss, 512);     // the size of the HTTP stream buffer
+        TEST_ASSERT_TRUE(extractor.satisfied());
+        parseUs += extractor.parseTimeUs();
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / PARSES;
+    size_t allocated = allocations - before;
+
+    TEST_ASSERT_EQUAL_MESSAGE(0, allocated, "the extractor allocated");
+
+    char message[160];
+    snprintf(message, sizeof(message), "%u byte feed: %.0f ns per parse (%.2f ns per byte), parseTimeUs %.1f, %u allocations",
+        (unsigned)rss.size(), ns, ns / rss.size(), double(parseUs) / PARSES, (unsigned)allocated);
+    TEST_MESSAGE(message);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fixture_in_1_7_and_whole_body_chunks);
+    RUN_TEST(test_satisfied_right_after_the_last_field);
+    RUN_TEST(test_line_breaks_become_dashes);
+    RUN_TEST(test_other_inline_tags_are_kept);
+    RUN_TEST(test_missing_fields);
+    RUN_TEST(test_titles_that_are_not_fields);
+    RUN_TEST(test_long_values_are_cut);
+    RUN_TEST(test_allocations_and_time_per_parse);
+    return UNITY_END();
+}
@@ -0,0 +1,319 @@
+// Row delta flush of LMDS against a recording SPI bus, through the Arduino SPI class and through
+// queued spi_master transactions: pio test -e native -f test_lmds_delta
+#include <unity.h>
+#include <LMDS.hpp>
+#include <native_runtime.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static const uint8_t MODULES = 4;
+static const uint8_t CS_PIN = 5;
+static const uint16_t NOOP = 0x0000;
+
+// the words of every CS low ... CS high frame in busLog, one entry per sent row
+static std::vector<std::vector<uint16_t>> sentRows()
+{
+    std::vector<std::vector<uint16_t>> rows;
+    bool selected = false;
+    for (const auto& event : busLog)
+    {
+        if (event.kind == MockBusEvent::PinWrite && event.pin == CS_PIN)
+        {
+            selected = event.value == LOW;
+            if (selected)
+                rows.emplace_back();
+        }
+        else if (event.kind == MockBusEvent::Transfer)
+        {
+            TEST_ASSERT_TRUE_MESSAGE(selected, "transfer outside of CS low");
+            rows.back().push_back(event.value);
+        }
+    }
+    return rows;
+}
+
+static uint16_t digit(uint8_t row, uint8_t data)
+{
+    return uint16_t(row + 1) << 8 | data;
+}
+
+static LMDS* display;
+
+void setUp()
+{
+    mockSpiBus().clockOnQueue = true;
+    display = new LMDS(MODULES, CS_PIN);
+    display->begin();
+    busLog.clear();
+}
+
+void tearDown()
+{
+    mockSpiClockOut();
+    delete display;
+    TEST_ASSERT_FALSE_MESSAGE(mockSpiBus().initialized, "the bus was not freed");
+}
+
+// the same test with the rows queued to spi_master
+static void inAsyncMode(void (*test)())
+{
+    TEST_ASSERT_TRUE(display->beginAsyncFlush());
+    TEST_ASSERT_EQUAL(CS_PIN, mockSpiBus().device->config.spics_io_num);
+    TEST_ASSERT_EQUAL(5000000, mockSpiBus().device->config.clock_speed_hz);
+    busLog.clear();
+    test();
+}
+
+// the bus events of a row as spi_master clocks it out, after it was queued
+static void expectClockedOut(std::vector<MockBusEvent>& expected, uint8_t row, const uint16_t* words)
+{
+    expected.push_back({MockBusEvent::PinWrite, CS_PIN, LOW});
+    for (uint8_t module = 0; module < MODULES; module++)
+        expected.push_back({MockBusEvent::Transfer, 0, words[module]});
+    expected.push_back({MockBusEvent::PinWrite, CS_PIN, HIGH});
+}
+
+static void checkBusLog(const std::vector<MockBusEvent>& expected)
+{
+    TEST_ASSERT_EQUAL(expected.size(), busLog.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        TEST_ASSERT_EQUAL_MESSAGE(expected[i].kind, busLog[i].kind, "event kind");
+        TEST_ASSERT_EQUAL_MESSAGE(expected[i].pin, busLog[i].pin, "pin");
+        TEST_ASSERT_EQUAL_HEX16(expected[i].value, busLog[i].value);
+    }
+}
+
+void test_first_frame_sends_every_row()
+{
+    display->rowPtr(3)[1] = 0x81;
+    display->present();
+
+    auto rows = sentRows();
+    TEST_ASSERT_EQUAL(8, rows.size());
+    for (uint8_t row = 0; row < 8; row++)
+        for (uint8_t module = 0; module < MODULES; module++)
+            TEST_ASSERT_EQUAL_HEX16(digit(row, row == 3 && module == 1 ? 0x81 : 0), rows[row][module]);
+
+    LMDS::FlushStats stats = display->getFlushStats();
+    TEST_ASSERT_EQUAL(1, stats.frames);
+    TEST_ASSERT_EQUAL(1, stats.fullFlushes);
+    TEST_ASSERT_EQUAL(8, stats.rowsSent);
+    TEST_ASSERT_EQUAL(0, stats.noops);
+    TEST_ASSERT_EQUAL(8 * MODULES * 2, stats.bytesSent);
+    TEST_ASSERT_EQUAL(0, stats.bytesSaved);
+}
+
+void test_unchanged_modules_get_a_noop()
+{
+    display->present();
+    busLog.clear();
+
+    display->rowPtr(5)[2] = 0x3C;
+    display->present();
+
+    auto rows = sentRows();
+    TEST_ASSERT_EQUAL(1, rows.size());
+    TEST_ASSERT_EQUAL(MODULES, rows[0].size());
+    TEST_ASSERT_EQUAL_HEX16(NOOP, rows[0][0]);
+    TEST_ASSERT_EQUAL_HEX16(NOOP, rows[0][1]);
+    TEST_ASSERT_EQUAL_HEX16(digit(5, 0x3C), rows[0][2]);
+    TEST_ASSERT_EQUAL_HEX16(NOOP, rows[0][3]);
+
+    LMDS::FlushStats stats = display->getFlushStats();
+    TEST_ASSERT_EQUAL(2, stats.frames);
+    TEST_ASSERT_EQUAL(1, stats.fullFlushes);
+    TEST_ASSERT_EQUAL(9, stats.rowsSent);
+    TEST_ASSERT_EQUAL(MODULES - 1, stats.noops);
+    TEST_ASSERT_EQUAL(9 * MODULES * 2, stats.bytesSent);
+    TEST_ASSERT_EQUAL(7 * MODULES * 2, stats.bytesSaved);
+}
+
+void test_unchanged_frame_sends_nothing()
+{
+    display->present();
+    busLog.clear();
+
+    display->present();
+
+    TEST_ASSERT_EQUAL(0, busLog.size());
+    LMDS::FlushStats stats = display->getFlushStats();
+    TEST_ASSERT_EQUAL(2, stats.frames);
+    TEST_ASSERT_EQUAL(8 * MODULES * 2, stats.bytesSent);
+    TEST_ASSERT_EQUAL(8 * MODULES * 2, stats.bytesSaved);
+}
+
+void test_half_the_rows_changed_is_still_a_delta()
+{
+    display->present();
+    busLog.clear();
+
+    for (uint8_t row : {0, 2, 4, 7})
+        display->rowPtr(row)[0] = 0xFF;
+    display->present();
+
+    auto rows = sentRows();
+    TEST_ASSERT_EQUAL(4, rows.size());
+    for (const auto& words : rows)
+        TEST_ASSERT_EQUAL(MODULES - 1, std::count(words.begin(), words.end(), NOOP));
+    TEST_ASSERT_EQUAL(1, display->getFlushStats().fullFlushes);
+    TEST_ASSERT_EQUAL(4 * (MODULES - 1), display->getFlushStats().noops);
+}
+
+void test_more_than_half_the_rows_changed_sends_every_row()
+{
+    display->present();
+    busLog.clear();
+
+    for (uint8_t row : {0, 1, 2, 3, 4})
+        display->rowPtr(row)[0] = 0xFF;
+    display->present();
+
+    auto rows = sentRows();
+    TEST_ASSERT_EQUAL(8, rows.size());
+    for (uint8_t row = 0; row < 8; row++)
+    {
+        TEST_ASSERT_EQUAL_HEX16(digit(row, row < 5 ? 0xFF : 0), rows[row][0]);
+        //a full flush sends the unchanged modules too
+        for (uint8_t module = 1; module < MODULES; module++)
+            TEST_ASSERT_EQUAL_HEX16(digit(row, 0), rows[row][module]);
+    }
+
+    LMDS::FlushStats stats = display->getFlushStats();
+    TEST_ASSERT_EQUAL(2, stats.fullFlushes);
+    TEST_ASSERT_EQUAL(0, stats.noops);
+    TEST_ASSERT_EQUAL(0, stats.bytesSaved);
+}
+
+// present() sends the frame before it returns, each row as its own CS low ... CS high frame with
+// module 0 first, rows in ascending order
+void test_present_sends_the_frame_in_order()
+{
+    for (uint8_t module = 0; module < MODULES; module++)
+        display->rowPtr(module)[module] = 0x80 | module;
+    size_t mirrored = mirroredFrames;
+    display->present();
+    TEST_ASSERT_EQUAL(mirrored + 1, mirroredFrames);
+    busLog.clear();
+
+    for (uint8_t row : {6, 1})
+        for (uint8_t module = 0; module < MODULES; module++)
+            display->rowPtr(row)[module] = row << 4 | module;
+    display->present();
+
+    std::vector<MockBusEvent> expected;
+    for (uint8_t row : {1, 6})
+    {
+        expected.push_back({MockBusEvent::PinWrite, CS_PIN, LOW});
+        expected.push_back({MockBusEvent::BeginTransaction, 0, 0});
+        for (uint8_t module = 0; module < MODULES; module++)
+            expected.push_back({MockBusEvent::Transfer, 0, digit(row, row << 4 | module)});
+        expected.push_back({MockBusEvent::PinWrite, CS_PIN, HIGH});
+        expected.push_back({MockBusEvent::EndTransaction, 0, 0});
+    }
+
+    checkBusLog(expected);
+    TEST_ASSERT_EQUAL(mirrored + 2, mirroredFrames);
+}
+
+void test_async_first_frame_sends_every_row() { inAsyncMode(test_first_frame_sends_every_row); }
+void test_async_unchanged_modules_get_a_noop() { inAsyncMode(test_unchanged_modules_get_a_noop); }
+void test_async_unchanged_frame_sends_nothing() { inAsyncMode(test_unchanged_frame_sends_nothing); }
+void test_async_half_the_rows_changed_is_still_a_delta() { inAsyncMode(test_half_the_rows_changed_is_still_a_delta); }
+void test_async_more_than_half_the_rows_changed_sends_every_row() { inAsyncMode(test_more_than_half_the_rows_changed_sends_every_row); }
+
+// present() queues one transaction per row in ascending order and returns before they are out,
+// the bus then clocks them out in that order with CS framing every row
+void test_async_present_queues_the_rows_in_order()
+{
+    TEST_ASSERT_TRUE(display->beginAsyncFlush());
+    display->present();
+    busLog.clear();
+    mockSpiBus().clockOnQueue = false;
+
+    for (uint8_t row : {6, 1, 3})
+        for (uint8_t module = 0; module < MODULES; module++)
+            display->rowPtr(row)[module] = row << 4 | module;
+    display->rowPtr(3)[2] = 0;      // unchanged, a no-op in its row
+    size_t mirrored = mirroredFrames;
+    display->present();
+    TEST_ASSERT_EQUAL(mirrored + 1, mirroredFrames);
+
+    std::vector<MockBusEvent> expected;
+    for (int i = 0; i < 3; i++)
+        expected.push_back({MockBusEvent::QueueTransaction, 0, MODULES});
+    checkBusLog(expected);
+
+    TEST_ASSERT_EQUAL(3, mockSpiClockOut());
+    for (uint8_t row : {1, 3, 6})
+    {
+        uint16_t words[MODULES];
+        for (uint8_t module = 0; module < MODULES; module++)
+            words[module] = row == 3 && module == 2 ? NOOP : digit(row, row << 4 | module);
+        expectClockedOut(expected, row, words);
+    }
+    checkBusLog(expected);
+    TEST_ASSERT_EQUAL(1, display->getFlushStats().noops);
+}
+
+// the next present() sleeps until the rows of the last frame are out, nothing of the new frame
+// is queued before that
+void test_async_present_waits_for_the_bus()
+{
+    TEST_ASSERT_TRUE(display->beginAsyncFlush());
+    display->present();
+    mockSpiBus().clockOnQueue = false;
+
+    display->rowPtr(2)[0] = 0x22;
+    display->present();
+    busLog.clear();
+
+    display->rowPtr(5)[3] = 0x55;
+    std::atomic<bool> presented(false);
+    std::thread renderer([&presented]() {
+        display->present();
+        presented = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    TEST_ASSERT_FALSE_MESSAGE(presented, "present() did not wait for the bus");
+    TEST_ASSERT_EQUAL(0, busLog.size());
+
+    //the interrupt of the last transaction wakes it
+    TEST_ASSERT_EQUAL(1, mockSpiClockOut());
+    renderer.join();
+    TEST_ASSERT_TRUE(presented);
+
+    std::vector<MockBusEvent> expected;
+    const uint16_t first[MODULES] = {digit(2, 0x22), NOOP, NOOP, NOOP};
+    expectClockedOut(expected, 2, first);
+    expected.push_back({MockBusEvent::QueueTransaction, 0, MODULES});
+    checkBusLog(expected);
+
+    TEST_ASSERT_EQUAL(1, mockSpiClockOut());
+    const uint16_t second[MODULES] = {NOOP, NOOP, NOOP, digit(5, 0x55)};
+    expectClockedOut(expected, 5, second);
+    checkBusLog(expected);
+    TEST_ASSERT_EQUAL(3, display->getFlushStats().frames);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_sends_every_row);
+    RUN_TEST(test_unchanged_modules_get_a_noop);
+    RUN_TEST(test_unchanged_frame_sends_nothing);
+    RUN_TEST(test_half_the_rows_changed_is_still_a_delta);
+    RUN_TEST(test_more_than_half_the_rows_changed_sends_every_row);
+    RUN_TEST(test_present_sends_the_frame_in_order);
+    RUN_TEST(test_async_first_frame_sends_every_row);
+    RUN_TEST(test_async_unchanged_modules_get_a_noop);
+    RUN_TEST(test_async_unchanged_frame_sends_nothing);
+    RUN_TEST(test_async_half_the_rows_changed_is_still_a_delta);
+    RUN_TEST(test_async_more_than_half_the_rows_changed_sends_every_row);
+    RUN_TEST(test_async_present_queues_the_rows_in_order);
+    RUN_TEST(test_async_present_waits_for_the_bus);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// Host tests for the packed 1bpp row blit used by copyCanvasToDisplay: pio test -e native
+#include <unity.h>
+#include <packed_rows.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int16_t ROWS = 8;
+
+static bool getPixel(const uint8_t* row, int32_t x)
+{
+    return row[x >> 3] & (0x80 >> (x & 7));
+}
+
+static void setPixel(uint8_t* row, int32_t x, bool on)
+{
+    if (on)
+        row[x >> 3] |= 0x80 >> (x & 7);
+    else
+        row[x >> 3] &= ~(0x80 >> (x & 7));
+}
+
+// what copyCanvasToDisplay did before, one getPixel/setPixel per pixel
+static void referenceBlit(const uint8_t* src, int32_t srcStride, int32_t srcWidth, int32_t srcX,
+                          uint8_t* dst, int32_t dstStride, int32_t dstWidth, int32_t dstX, int32_t count)
+{
+    for (int16_t y = 0; y < ROWS; y++)
+        for (int32_t i = 0; i < count; i++)
+        {
+            int32_t dx = dstX + i;
+            int32_t sx = srcX + i;
+            if (dx < 0 || dx >= dstWidth)
+                continue;
+            setPixel(dst + y * dstStride, dx, sx >= 0 && sx < srcWidth && getPixel(src + y * srcStride, sx));
+        }
+}
+
+static void randomize(std::vector<uint8_t>& buffer)
+{
+    for (auto& b : buffer)
+        b = rand();
+}
+
+// blits with the given geometry into a random destination and compares with the reference
+static void checkBlit(int32_t srcWidth, int32_t srcX, int32_t dstWidth, int32_t dstX, int32_t count)
+{
+    int32_t srcStride = (srcWidth + 7) / 8;
+    int32_t dstStride = (dstWidth + 7) / 8;
+    std::vector<uint8_t> src(srcStride * ROWS), dst(dstStride * ROWS);
+    randomize(src);
+    randomize(dst);
+    std::vector<uint8_t> expected = dst;
+
+    blitPackedRows(src.data(), srcStride, srcWidth, srcX, dst.data(), dstStride, dstWidth, dstX, count, ROWS);
+    referenceBlit(src.data(), srcStride, srcWidth, srcX, expected.data(), dstStride, dstWidth, dstX, count);
+
+    char message[96];
+    snprintf(message, sizeof(message), "src %d@%d dst %d@%d count %d", srcWidth, srcX, dstWidth, dstX, count);
+    TEST_ASSERT_TRUE_MESSAGE(memcmp(dst.data(), expected.data(), dst.size()) == 0, message);
+}
+
+void setUp() { srand(1); }
+void tearDown() {}
+
+void test_read_packed_byte_reads_zero_outside_the_row()
+{
+    const uint8_t row[] = {0xFF, 0xFF};
+    TEST_ASSERT_EQUAL_HEX8(0xFF, readPackedByte(row, 16, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFC, readPackedByte(row, 10, 4));
+    TEST_ASSERT_EQUAL_HEX8(0x0F, readPackedByte(row, 16, -4));
+    TEST_ASSERT_EQUAL_HEX8(0x00, readPackedByte(row, 16, -8));
+    TEST_ASSERT_EQUAL_HEX8(0x00, readPackedByte(row, 16, 16));
+    TEST_ASSERT_EQUAL_HEX8(0x80, readPackedByte(row, 16, 15));
+}
+
+void test_blit_matches_reference_at_unaligned_offsets()
+{
+    for (int32_t srcX = 0; srcX < 17; srcX++)
+        for (int32_t dstX = 0; dstX < 17; dstX++)
+            checkBlit(64, srcX, 64, dstX, 40);
+}
+
+void test_blit_clips_at_the_edges()
+{
+    //destination offsets before and past the frame, counts running over both ends
+    const int32_t offsets[] = {-70, -64, -9, -8, -7, -1, 0, 1, 7, 55, 57, 63, 64, 65};
+    const int32_t counts[] = {0, 1, 7, 8, 9, 63, 64, 65, 140};
+    for (int32_t dstX : offsets)
+        for (int32_t count : counts)
+            checkBlit(64, 0, 64, dstX, count);
+}
+
+void test_blit_reads_past_the_source_as_zero()
+{
+    //source widths that end inside a byte, source offsets past the end and before the start
+    const int32_t widths[] = {1, 5, 8, 13, 31};
+    const int32_t sources[] = {-9, -3, 0, 3, 12, 40};
+    for (int32_t srcWidth : widths)
+        for (int32_t srcX : sources)
+            for (int32_t dstX = -3; dstX < 12; dstX += 5)
+                checkBlit(srcWidth, srcX, 64, dstX, 64);
+}
+
+void test_blit_destination_not_a_multiple_of_eight()
+{
+    for (int32_t dstWidth : {5, 12, 61})
+        for (int32_t dstX = -9; dstX < dstWidth + 2; dstX += 3)
+            checkBlit(96, 7, dstWidth, dstX, 70);
+}
+
+// Not an assertion, prints the speedup over the per-pixel copy for a 64x8 frame
+void test_blit_benchmark()
+{
+    const int32_t width = 64, stride = width / 8, iterations = 20000;
+    std::vector<uint8_t> src(stride * ROWS * 2), dst(stride * ROWS);
+    randomize(src);
+
+    typedef std::chrono::steady_clock Clock;
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+        blitPackedRows(src.data(), stride * 2, width * 2, i % 61, dst.data(), stride, width, 0, width, ROWS);
+    auto blit = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+        referenceBlit(src.data(), stride * 2, width * 2, i % 61, dst.data(), stride, width, 0, width);
+    auto reference = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+    char message[96];
+    snprintf(message, sizeof(message), "64x8 frame: blit %lld ns, per pixel %lld ns",
+        (long long)(blit / iterations), (long long)(reference / iterations));
+    TEST_MESSAGE(message);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_read_packed_byte_reads_zero_outside_the_row);
+    RUN_TEST(test_blit_matches_reference_at_unaligned_offsets);
+    RUN_TEST(test_blit_clips_at_the_edges);
+    RUN_TEST(test_blit_reads_past_the_source_as_zero);
+    RUN_TEST(test_blit_destination_not_a_multiple_of_eight);
+    RUN_TEST(test_blit_benchmark);
+    return UNITY_END();
+}
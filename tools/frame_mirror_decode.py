@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Decodes the binary frame mirror (see include/frame_mirror.hpp) from a serial port or a capture file.
+
+Text written by the firmware between packets is passed through unchanged,
+frames are printed as '#' art together with the frame counter.
+
+    frame_mirror_decode.py /dev/ttyACM0          # live, needs pyserial
+    frame_mirror_decode.py capture.bin           # from a file
+"""
+
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+HEADER = struct.Struct("<BHHH")  # encoding, counter, columns, payload length
+ENCODING_RAW = 0
+ENCODING_RLE = 1
+
+
+def decode_payload(encoding, payload, columns):
+    if encoding == ENCODING_RAW:
+        data = payload
+    elif encoding == ENCODING_RLE:
+        data = bytearray()
+        for i in range(0, len(payload) - 1, 2):
+            data += bytes([payload[i + 1]]) * payload[i]
+    else:
+        return None
+    return bytes(data) if len(data) == columns else None
+
+
+def render(columns):
+    return "\n".join(
+        "".join("#" if col & (1 << y) else " " for col in columns) for y in range(8)
+    )
+
+
+class Decoder:
+    def __init__(self, out):
+        self.out = out
+        self.buffer = bytearray()
+        self.last_counter = None
+        self.frames = 0
+        self.dropped = 0
+        self.errors = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # keep a possible first sync byte for the next read
+                keep = 1 if self.buffer.endswith(SYNC[:1]) else 0
+                self._text(self.buffer[: len(self.buffer) - keep])
+                del self.buffer[: len(self.buffer) - keep]
+                return
+            self._text(self.buffer[:start])
+            del self.buffer[:start]
+
+            if len(self.buffer) < 2 + HEADER.size:
+                return
+            encoding, counter, columns, size = HEADER.unpack_from(self.buffer, 2)
+            end = 2 + HEADER.size + size + 1
+            if len(self.buffer) < end:
+                return
+
+            payload = bytes(self.buffer[2 + HEADER.size : end - 1])
+            checksum = 0
+            for b in payload:
+                checksum ^= b
+            frame = decode_payload(encoding, payload, columns)
+            if frame is None or checksum != self.buffer[end - 1]:
+                # not a real packet, emit the sync byte as text and resync after it
+                self.errors += 1
+                self._text(self.buffer[:1])
+                del self.buffer[:1]
+                continue
+
+            del self.buffer[:end]
+            self._frame(counter, frame)
+
+    def _text(self, data):
+        if data:
+            self.out.write(data.decode("utf-8", errors="replace"))
+
+    def _frame(self, counter, columns):
+        if self.last_counter is not None:
+            self.dropped += (counter - self.last_counter - 1) & 0xFFFF
+        self.last_counter = counter
+        self.frames += 1
+        self.out.write("--- frame %d (%d columns, %d skipped so far)\n" % (counter, len(columns), self.dropped))
+        self.out.write(render(columns) + "\n")
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+
+    decoder = Decoder(sys.stdout)
+    path = sys.argv[1]
+    if path.startswith("/dev/") or path.upper().startswith("COM"):
+        import serial
+
+        with serial.Serial(path, 1000000, timeout=0.1) as port:
+            while True:
+                decoder.feed(port.read(4096))
+                sys.stdout.flush()
+    else:
+        with open(path, "rb") as f:
+            decoder.feed(f.read())
+        sys.stderr.write("%d frames, %d skipped, %d bad packets\n" % (decoder.frames, decoder.dropped, decoder.errors))
+
+
+if __name__ == "__main__":
+    main()
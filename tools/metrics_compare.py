@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compares two "metrics" dumps (see Metrics::dump() in include/metrics.hpp), e.g. a task mode and
+an EVENT_LOOP_MODE build of the same firmware, and prints heap and task stack side by side.
+
+Anything outside "#metrics begin" / "#metrics end" is ignored, so a whole serial log can be
+passed in; the last dump of each file is used.
+
+    metrics_compare.py tasks.log event_loop.log
+"""
+
+import sys
+
+
+def parse(path):
+    dumps = []
+    current = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("#metrics begin"):
+                current = {"heap": [], "task": {}}
+            elif line.startswith("#metrics end") and current is not None:
+                dumps.append(current)
+                current = None
+            elif current is not None and not line.startswith("#"):
+                fields = line.split(",")
+                if fields[0] == "heap" and len(fields) == 6:
+                    current["heap"].append([int(v) for v in fields[1:]])
+                elif fields[0] == "task" and len(fields) == 5:
+                    current["task"][fields[1]] = [int(v) for v in fields[2:]]
+    if not dumps:
+        sys.exit("%s: no complete metrics dump" % path)
+    return dumps[-1]
+
+
+def value(v):
+    return "-" if v is None else str(v)
+
+
+def row(name, before, after):
+    delta = "" if before is None or after is None else "%+d" % (after - before)
+    print("%-34s %10s %10s %10s" % (name, value(before), value(after), delta))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    before, after = parse(sys.argv[1]), parse(sys.argv[2])
+
+    print("%-34s %10s %10s %10s" % ("", sys.argv[1][-10:], sys.argv[2][-10:], "delta"))
+    # the last sample for the free heap, the lowest of all samples for the minimum
+    row("heap free (last sample)", before["heap"][-1][1] if before["heap"] else None,
+        after["heap"][-1][1] if after["heap"] else None)
+    row("heap min free", min(s[2] for s in before["heap"]) if before["heap"] else None,
+        min(s[2] for s in after["heap"]) if after["heap"] else None)
+    row("heap largest block (last sample)", before["heap"][-1][3] if before["heap"] else None,
+        after["heap"][-1][3] if after["heap"] else None)
+
+    reserved = [sum(t[0] for t in d["task"].values()) for d in (before, after)]
+    row("stack reserved, all tasks", reserved[0], reserved[1])
+    for name in sorted(set(before["task"]) | set(after["task"])):
+        b, a = before["task"].get(name), after["task"].get(name)
+        row(name + " size", b and b[0], a and a[0])
+        row(name + " max used", b and b[2], a and a[2])
+
+
+if __name__ == "__main__":
+    main()